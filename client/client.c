@@ -14,14 +14,28 @@
 
 #define PORT 3000
 #define BUFSIZE 1024
+#define READ_BUFSIZE 8192
 
-static ssize_t recv_line(int sock, char *buf, size_t bufsize) {
+// Bytes received from the server but not yet handed out. Lines and file
+// data are taken from here first, and the buffer is refilled with one large
+// recv() instead of one recv() per byte.
+typedef struct {
+    char data[READ_BUFSIZE];
+    size_t start;
+    size_t end;
+} LineReader;
+
+static ssize_t recv_line(int sock, LineReader *r, char *buf, size_t bufsize) {
     size_t idx = 0;
     while (idx + 1 < bufsize) {
-        char c;
-        ssize_t r = recv(sock, &c, 1, 0);
-        if (r == 0) return 0; // closed
-        if (r < 0) return -1;
+        if (r->start == r->end) {
+            ssize_t n = recv(sock, r->data, sizeof(r->data), 0);
+            if (n == 0) return 0; // closed
+            if (n < 0) return -1;
+            r->start = 0;
+            r->end = (size_t)n;
+        }
+        char c = r->data[r->start++];
         if (c == '\n') break;
         if (c == '\r') continue;
         buf[idx++] = c;
@@ -30,6 +44,18 @@ static ssize_t recv_line(int sock, char *buf, size_t bufsize) {
     return (ssize_t)idx;
 }
 
+// Raw file data: what is already buffered, else straight from the socket
+static ssize_t recv_data(int sock, LineReader *r, char *buf, size_t len) {
+    if (r->start < r->end) {
+        size_t n = r->end - r->start;
+        if (n > len) n = len;
+        memcpy(buf, r->data + r->start, n);
+        r->start += n;
+        return (ssize_t)n;
+    }
+    return recv(sock, buf, len, 0);
+}
+
 int main(int argc, char **argv) {
     const char *server_ip = "127.0.0.1";
     if (argc >= 2) server_ip = argv[1];
@@ -37,6 +63,7 @@ int main(int argc, char **argv) {
     int sockfd;
     struct sockaddr_in serv_addr;
     char buf[BUFSIZE];
+    LineReader reader = { .start = 0, .end = 0 };
 
     sockfd = socket(AF_INET, SOCK_STREAM, 0);
     if (sockfd < 0) {
@@ -62,7 +89,7 @@ int main(int argc, char **argv) {
     // Read loop: server will send lines; when a prompt 'Enter choice' appears,
     // read user input and send it.
     while (1) {
-        ssize_t r = recv_line(sockfd, buf, sizeof(buf));
+        ssize_t r = recv_line(sockfd, &reader, buf, sizeof(buf));
         if (r == 0) {
             printf("Server closed connection.\n");
             break;
@@ -78,7 +105,7 @@ int main(int argc, char **argv) {
             fflush(stdout);
             
             // Read file size
-            r = recv_line(sockfd, buf, sizeof(buf));
+            r = recv_line(sockfd, &reader, buf, sizeof(buf));
             if (r <= 0 || strncmp(buf, "FILE_SIZE:", 10) != 0) {
                 printf("❌ Error receiving file size\n");
                 break;
@@ -97,7 +124,7 @@ int main(int argc, char **argv) {
                 long remaining = filesize;
                 while (remaining > 0) {
                     size_t to_read = (remaining > sizeof(discard)) ? sizeof(discard) : remaining;
-                    ssize_t n = recv(sockfd, discard, to_read, 0);
+                    ssize_t n = recv_data(sockfd, &reader, discard, to_read);
                     if (n <= 0) break;
                     remaining -= n;
                 }
@@ -113,7 +140,7 @@ int main(int argc, char **argv) {
                 size_t to_receive = filesize - received;
                 if (to_receive > sizeof(filebuf)) to_receive = sizeof(filebuf);
                 
-                ssize_t n = recv(sockfd, filebuf, to_receive, 0);
+                ssize_t n = recv_data(sockfd, &reader, filebuf, to_receive);
                 if (n <= 0) {
                     printf("\n❌ Error receiving file data\n");
                     fclose(outfile);
@@ -142,7 +169,7 @@ int main(int argc, char **argv) {
             fflush(stdout);
             
             // Read completion marker
-            r = recv_line(sockfd, buf, sizeof(buf));
+            r = recv_line(sockfd, &reader, buf, sizeof(buf));
             if (r > 0 && strcmp(buf, "FILE_TRANSFER_COMPLETE") == 0) {
                 printf("✨ Transfer completed!\n\n");
             }
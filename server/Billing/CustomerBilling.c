@@ -4,47 +4,19 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include "../Header/CustBillProcess.h"
+#include "../Header/ResultStore.h"
+#include "../Header/FileTransfer.h"
+#include "../Header/Log.h"
 
 #define BUFSIZE 1024
 
-// Send all helper for socket - ensures complete data transmission
-static int sendall_fd(int sock, const char *buf, size_t len) {
-    size_t total = 0;
-    int retry_count = 0;
-    const int MAX_RETRIES = 3;
-    
-    while (total < len) {
-        ssize_t n = send(sock, buf + total, len - total, 0);
-        
-        if (n > 0) {
-            total += n;
-            retry_count = 0; // Reset retry count on success
-        } else if (n == 0) {
-            // Connection closed
-            return -1;
-        } else {
-            // Error occurred
-            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
-                // Temporary error - retry
-                retry_count++;
-                if (retry_count > MAX_RETRIES) {
-                    return -1;
-                }
-                usleep(1000); // Wait 1ms before retry
-                continue;
-            }
-            // Permanent error
-            return -1;
-        }
-    }
-    return 0;
-}
-
 // Send a line with newline appended
 static int send_line_fd(int sock, const char *s) {
     char tmp[BUFSIZE];
@@ -53,60 +25,256 @@ static int send_line_fd(int sock, const char *s) {
         // Message truncated, but still try to send
         len = BUFSIZE - 1;
     }
-    return sendall_fd(sock, tmp, len);
+    return send_all(sock, tmp, len);
 }
 
-// Search for a customer by MSISDN and send results to client
-void search_msisdn(int client_fd, const char *filename, long msisdn) {
-    FILE *file = fopen(filename, "r");
-    char line[1024];
+// Send the first CB_RECORD_LINES lines of a record, one line at a time
+// (the record text is modified in place)
+static void send_record_lines(int client_fd, char *record) {
+    char *line = record;
+    for (int i = 0; i < CB_RECORD_LINES && *line; i++) {
+        char *nl = strchr(line, '\n');
+        if (nl) *nl = '\0';
+        line[strcspn(line, "\r")] = 0;
+        send_line_fd(client_fd, line);
+        if (!nl) break;
+        line = nl + 1;
+    }
+}
+
+/* ============================================================
+   Resident Results Lookup
+   ============================================================ */
+
+// Answer from the in-memory snapshot of the report's directory.
+// Returns 1 if found, 0 if not found, -1 if no snapshot is resident.
+static int snapshot_lookup(int client_fd, const char *filename, long msisdn) {
+    const ResultSnapshot *snap = resultStoreAcquireFor(filename);
+    if (!snap) return -1;
+
     int found = 0;
-    
-    if (!file) {
-        char errMsg[256];
-        snprintf(errMsg, sizeof(errMsg), "Error opening file: %s", strerror(errno));
-        send_line_fd(client_fd, errMsg);
-        send_line_fd(client_fd, "Note: Please process the CDR data first (option 1 from secondary menu).");
-        return;
+    const Customer *cust = findCustomer(&snap->customers, msisdn);
+    if (cust) {
+        char record[CB_RECORD_MAX];
+        int len = formatCustomerRecord(record, sizeof(record), cust);
+        if (len > 0 && (size_t)len < sizeof(record)) {
+            send_record_lines(client_fd, record + 1); // skip the leading blank line
+            found = 1;
+        }
+    }
+
+    resultStoreRelease(snap);
+    return found;
+}
+
+/* ============================================================
+   Columnar Results Lookup
+   ============================================================ */
+
+// Path of a file (CB.col, CB.idx) that sits next to the given CB.txt
+static void sibling_path(const char *filename, const char *name, char *out, size_t size) {
+    const char *slash = strrchr(filename, '/');
+    int dirlen = slash ? (int)(slash - filename) : 0;
+    if (slash)
+        snprintf(out, size, "%.*s/%s", dirlen, filename, name);
+    else
+        snprintf(out, size, "%s", name);
+}
+
+// Answer from CB.col by scanning its MSISDN column.
+// Returns 1 if found, 0 if not found, -1 if there is no usable CB.col.
+static int column_lookup(int client_fd, const char *filename, long msisdn) {
+    char path[512];
+    sibling_path(filename, CB_COLUMN_FILE, path, sizeof(path));
+
+    CBColumns cols;
+    if (openCBColumns(&cols, path) != 0) return -1;
+
+    int found = 0;
+    Customer cust;
+    int64_t row = findCBColumnRow(&cols, msisdn);
+    if (row >= 0 && loadCBColumnRow(&cols, (uint64_t)row, &cust) != 0) {
+        found = -1; // corrupt row: answer from the text report
+    } else if (row >= 0) {
+        char record[CB_RECORD_MAX];
+        int len = formatCustomerRecord(record, sizeof(record), &cust);
+        if (len > 0 && (size_t)len < sizeof(record)) {
+            send_record_lines(client_fd, record + 1); // skip the leading blank line
+            found = 1;
+        }
+    }
+
+    closeCBColumns(&cols);
+    return found;
+}
+
+/* ============================================================
+   Index Lookup
+   ============================================================ */
+
+// Probe CB.idx for msisdn. Returns 1 with the record's location, 0 if the
+// index is current and has no such customer, -1 if the index is missing or
+// was not written for this CB.txt (the caller then scans the report).
+static int index_lookup(const char *filename, long report_size, long msisdn,
+                        CBIndexEntry *found) {
+    char path[512];
+    sibling_path(filename, CB_INDEX_FILE, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    CBIndexHeader header;
+    int rc = -1;
+    if (pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+        memcmp(header.magic, CB_INDEX_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == CB_INDEX_VERSION &&
+        header.reportSize == (uint64_t)report_size &&
+        header.capacity > 0 && (header.capacity & (header.capacity - 1)) == 0 &&
+        msisdn != CUST_EMPTY_KEY) {
+
+        // Same probe sequence as the in-memory customer table
+        uint64_t mask = header.capacity - 1;
+        uint64_t slot = hashFunction(msisdn) & mask;
+        for (uint64_t probes = 0; probes < header.capacity; probes++) {
+            CBIndexEntry e;
+            off_t at = (off_t)(sizeof(header) + slot * sizeof(CBIndexEntry));
+            if (pread(fd, &e, sizeof(e), at) != (ssize_t)sizeof(e)) break;
+            if (e.msisdn == msisdn) {
+                *found = e;
+                rc = 1;
+                break;
+            }
+            if (e.msisdn == CUST_EMPTY_KEY) {
+                rc = 0;
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
     }
 
+    close(fd);
+    return rc;
+}
+
+// Read one indexed record and send its first CB_RECORD_LINES lines.
+// Returns 0 if the bytes at the indexed offset are not that customer.
+static int send_indexed_record(int client_fd, FILE *file, const CBIndexEntry *e) {
+    char *record = (char *)malloc((size_t)e->length + 1);
+    if (!record) return 0;
+
+    ssize_t n = pread(fileno(file), record, e->length, (off_t)e->offset);
+    if (n != (ssize_t)e->length) {
+        free(record);
+        return 0;
+    }
+    record[n] = '\0';
+
+    // Guard against an index that outlived its report
+    char expect[64];
+    snprintf(expect, sizeof(expect), "Customer ID: %ld ", (long)e->msisdn);
+    if (strncmp(record, expect, strlen(expect)) != 0) {
+        free(record);
+        return 0;
+    }
+
+    send_record_lines(client_fd, record);
+    free(record);
+    return 1;
+}
+
+/* ============================================================
+   Customer Search
+   ============================================================ */
+
+// Linear scan of CB.txt (used when there is no usable index)
+static int scan_for_msisdn(int client_fd, FILE *file, long msisdn) {
+    char line[1024];
+
     while (fgets(line, sizeof(line), file)) {
         // Look for line starting with "Customer ID: "
         if (strstr(line, "Customer ID: ") != NULL) {
             long current_msisdn;
             if (sscanf(line, "Customer ID: %ld", &current_msisdn) == 1) {
                 if (current_msisdn == msisdn) {
-                    found = 1;
                     // Send this line and next 11 lines for complete customer info
                     line[strcspn(line, "\r\n")] = 0; // remove newline
                     send_line_fd(client_fd, line);
                     
-                    for (int i = 0; i < 11; i++) {
+                    for (int i = 0; i < CB_RECORD_LINES - 1; i++) {
                         if (fgets(line, sizeof(line), file)) {
                             line[strcspn(line, "\r\n")] = 0;
                             send_line_fd(client_fd, line);
                         }
                     }
-                    break;
+                    return 1;
                 }
             }
         }
     }
+    return 0;
+}
+
+// Look the customer up in CB.txt via its index, or by scanning it.
+// Returns 1 if found, 0 if not, -1 if the report cannot be opened.
+static int report_lookup(int client_fd, const char *filename, long msisdn) {
+    FILE *file = fopen(filename, "r");
+    
+    if (!file) {
+        char errMsg[256];
+        snprintf(errMsg, sizeof(errMsg), "Error opening file: %s", strerror(errno));
+        send_line_fd(client_fd, errMsg);
+        send_line_fd(client_fd, "Note: Please process the CDR data first (option 1 from secondary menu).");
+        return -1;
+    }
+
+    // Prefer the MSISDN index; scan the report only if it cannot answer
+    struct stat st;
+    CBIndexEntry entry;
+    int found = 0;
+    int rc = (fstat(fileno(file), &st) == 0)
+                 ? index_lookup(filename, (long)st.st_size, msisdn, &entry) : -1;
+
+    if (rc == 1 && send_indexed_record(client_fd, file, &entry))
+        found = 1;
+    else if (rc != 0)
+        found = scan_for_msisdn(client_fd, file, msisdn);
+
+    fclose(file);
+    return found;
+}
+
+// Search for a customer by MSISDN and send results to client
+void search_msisdn(int client_fd, const char *filename, long msisdn) {
+    // Resident results answer without touching the report, then CB.col;
+    // CB.txt is only read when neither is available
+    int found = snapshot_lookup(client_fd, filename, msisdn);
+    if (found < 0)
+        found = column_lookup(client_fd, filename, msisdn);
+    if (found < 0)
+        found = report_lookup(client_fd, filename, msisdn);
+    if (found < 0)
+        return;
 
     if (!found) {
         char notFoundMsg[256];
         snprintf(notFoundMsg, sizeof(notFoundMsg), "Customer with MSISDN %ld not found.", msisdn);
         send_line_fd(client_fd, notFoundMsg);
     }
-
-    fclose(file);
 }
 
 
 void display_customer_billing_file(int client_fd, const char *filename) {
-    FILE *file = fopen(filename, "rb");
+    // CB.txt is generated from CB.col when missing or out of date
+    char column_path[512];
+    char index_path[512];
+    sibling_path(filename, CB_COLUMN_FILE, column_path, sizeof(column_path));
+    sibling_path(filename, CB_INDEX_FILE, index_path, sizeof(index_path));
+    if (colFileExportStale(column_path, filename))
+        exportCBText(column_path, filename, index_path);
 
-    if (!file) {
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0) {
         char msg[512];
         snprintf(msg, sizeof(msg), "Error opening file: %s", strerror(errno));
         send_line_fd(client_fd, msg);
@@ -114,30 +282,9 @@ void display_customer_billing_file(int client_fd, const char *filename) {
         send_line_fd(client_fd, msg);
         return;
     }
-    
-    // Get file size
-    fseek(file, 0, SEEK_END);
-    long filesize = ftell(file);
-    rewind(file);
-    
-    // Send file transfer marker and transfer the file directly
-    send_line_fd(client_fd, "FILE_TRANSFER_START:CB.txt");
-    
-    // Send file size
-    char size_msg[64];
-    snprintf(size_msg, sizeof(size_msg), "FILE_SIZE:%ld", filesize);
-    send_line_fd(client_fd, size_msg);
-    
-    // Send file data in chunks
-    char buffer[8192];
-    size_t bytes_read;
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
-        if (sendall_fd(client_fd, buffer, bytes_read) != 0) {
-            fclose(file);
-            return;
-        }
-    }
-    
-    fclose(file);
-    send_line_fd(client_fd, "FILE_TRANSFER_COMPLETE");
-}
\ No newline at end of file
+
+    // Transfer the file straight from the page cache
+    if (send_file_transfer(client_fd, fd, "CB.txt") != 0)
+        LOG_WARN("CB.txt download to client fd %d failed partway", client_fd);
+    close(fd);
+}
@@ -0,0 +1,94 @@
+// FileTransfer.c - Zero-copy download of report files to the client
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include "../Header/FileTransfer.h"
+
+int wait_writable(int sock) {
+    struct pollfd pfd = { sock, POLLOUT, 0 };
+    for (;;) {
+        int n = poll(&pfd, 1, TRANSFER_WAIT_MS);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1; // error or timed out
+        return (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) ? -1 : 0;
+    }
+}
+
+int send_all(int sock, const char *buf, size_t len) {
+    size_t total = 0;
+    while (total < len) {
+        ssize_t n = send(sock, buf + total, len - total, MSG_NOSIGNAL);
+        if (n > 0) {
+            total += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (wait_writable(sock) != 0) return -1;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Copy through a buffer for files sendfile() cannot handle
+static int copy_all(int sock, int file_fd, off_t offset, size_t len) {
+    char *buf = (char *)malloc(TRANSFER_COPY_CHUNK);
+    if (!buf) return -1;
+    int rc = 0;
+    while (len > 0 && rc == 0) {
+        size_t want = len < TRANSFER_COPY_CHUNK ? len : TRANSFER_COPY_CHUNK;
+        ssize_t n = pread(file_fd, buf, want, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            rc = -1; // read error, or the file shrank
+            break;
+        }
+        rc = send_all(sock, buf, (size_t)n);
+        offset += n;
+        len -= (size_t)n;
+    }
+    free(buf);
+    return rc;
+}
+
+int sendfile_all(int sock, int file_fd, off_t offset, size_t len) {
+    while (len > 0) {
+        ssize_t n = sendfile(sock, file_fd, &offset, len);
+        if (n > 0) {
+            len -= (size_t)n;
+        } else if (n == 0) {
+            return -1; // the file shrank
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (wait_writable(sock) != 0) return -1;
+        } else if (errno == EINVAL || errno == ENOSYS) {
+            return copy_all(sock, file_fd, offset, len);
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int send_file_transfer(int sock, int file_fd, const char *name) {
+    struct stat st;
+    if (fstat(file_fd, &st) != 0) return -1;
+
+    char header[320];
+    int len = snprintf(header, sizeof(header), "FILE_TRANSFER_START:%s\nFILE_SIZE:%lld\n",
+                       name, (long long)st.st_size);
+    if (len < 0 || (size_t)len >= sizeof(header)) return -1;
+    if (send_all(sock, header, (size_t)len) != 0) return -1;
+
+    if (sendfile_all(sock, file_fd, 0, (size_t)st.st_size) != 0) return -1;
+
+    static const char done[] = "FILE_TRANSFER_COMPLETE\n";
+    return send_all(sock, done, sizeof(done) - 1);
+}
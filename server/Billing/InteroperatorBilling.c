@@ -5,17 +5,19 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include "../Header/IntopBillProcess.h"
+#include "../Header/ResultStore.h"
+#include "../Header/FileTransfer.h"
+#include "../Header/Log.h"
 
 #define MAX_LINE 1024
 
 // Helper function to send a line to client via socket
 static int send_line_fd(int fd, const char *line) {
-    size_t len = strlen(line);
-    ssize_t sent = send(fd, line, len, 0);
-    return (sent == (ssize_t)len) ? 0 : -1;
+    return send_all(fd, line, strlen(line));
 }
 
 // Helper function to convert a string to lowercase
@@ -25,7 +27,108 @@ static void to_lowercase(char *str) {
     }
 }
 
+// Send the operator's record if its brand line contains operator_lower, with
+// the same match as the IOSB.txt scan. Returns 1 if it matched.
+static int send_if_match(int client_fd, const OpNode *node, const char *operator_lower) {
+    char record[IOSB_RECORD_MAX];
+    int len = format_operator_record(record, sizeof(record), node);
+    if (len < 0) return 0;
+
+    // Match on the brand line only
+    char brand_lower[MAX_LINE];
+    size_t brand_len = strcspn(record, "\n");
+    if (brand_len >= sizeof(brand_lower)) brand_len = sizeof(brand_lower) - 1;
+    memcpy(brand_lower, record, brand_len);
+    brand_lower[brand_len] = '\0';
+    to_lowercase(brand_lower);
+    if (!strstr(brand_lower, operator_lower)) return 0;
+
+    if ((size_t)len < sizeof(record)) {
+        send_all(client_fd, record, (size_t)len);
+    } else {
+        char *big = (char *)malloc((size_t)len + 1);
+        if (big) {
+            format_operator_record(big, (size_t)len + 1, node);
+            send_all(client_fd, big, (size_t)len);
+            free(big);
+        }
+    }
+    return 1;
+}
+
+// Answer from the in-memory snapshot of the report's directory, walking the
+// operators in IOSB.txt order.
+// Returns 1 if found, 0 if not found, -1 if no snapshot is resident.
+static int snapshot_search(int client_fd, const char *filename, const char *operator_lower) {
+    const ResultSnapshot *snap = resultStoreAcquireFor(filename);
+    if (!snap) return -1;
+
+    size_t count;
+    const OpNode **nodes = list_operators(&snap->operators, &count);
+    if (!nodes) {
+        resultStoreRelease(snap);
+        return -1;
+    }
+
+    int found = 0;
+    for (size_t i = 0; i < count && !found; i++)
+        found = send_if_match(client_fd, nodes[i], operator_lower);
+
+    free(nodes);
+    resultStoreRelease(snap);
+    return found;
+}
+
+// Path of the IOSB.col that sits next to the given IOSB.txt
+static void column_path_for(const char *filename, char *out, size_t size) {
+    const char *slash = strrchr(filename, '/');
+    int dirlen = slash ? (int)(slash - filename) : 0;
+    if (slash)
+        snprintf(out, size, "%.*s/%s", dirlen, filename, IOSB_COLUMN_FILE);
+    else
+        snprintf(out, size, "%s", IOSB_COLUMN_FILE);
+}
+
+// Answer from IOSB.col, whose rows are in IOSB.txt order.
+// Returns 1 if found, 0 if not found, -1 if there is no usable IOSB.col.
+static int column_search(int client_fd, const char *filename, const char *operator_lower) {
+    char path[512];
+    column_path_for(filename, path, sizeof(path));
+
+    IOSBColumns cols;
+    if (open_iosb_columns(&cols, path) != 0) return -1;
+
+    int found = 0;
+    for (uint64_t r = 0; r < cols.rows && !found; r++) {
+        OpNode node;
+        load_iosb_column_row(&cols, r, &node);
+        found = send_if_match(client_fd, &node, operator_lower);
+    }
+
+    close_iosb_columns(&cols);
+    return found;
+}
+
 void search_operator(int client_fd, const char *filename, const char *operator_input) {
+    // Convert user input to lowercase
+    char operator_lower[100];
+    strncpy(operator_lower, operator_input, sizeof(operator_lower) - 1);
+    operator_lower[sizeof(operator_lower) - 1] = '\0';
+    to_lowercase(operator_lower);
+
+    // Resident results answer without touching the report, then IOSB.col
+    int resident = snapshot_search(client_fd, filename, operator_lower);
+    if (resident < 0)
+        resident = column_search(client_fd, filename, operator_lower);
+    if (resident >= 0) {
+        if (!resident) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "Operator '%s' not found.\n", operator_input);
+            send_line_fd(client_fd, msg);
+        }
+        return;
+    }
+
     FILE *file = fopen(filename, "r");
     char line[MAX_LINE];
     int found = 0;
@@ -40,12 +143,6 @@ void search_operator(int client_fd, const char *filename, const char *operator_i
         return;
     }
 
-    // Convert user input to lowercase
-    char operator_lower[100];
-    strncpy(operator_lower, operator_input, sizeof(operator_lower) - 1);
-    operator_lower[sizeof(operator_lower) - 1] = '\0';
-    to_lowercase(operator_lower);
-
     while (fgets(line, sizeof(line), file)) {
         // Make a lowercase copy of the line
         char line_lower[MAX_LINE];
@@ -84,39 +181,58 @@ void search_operator(int client_fd, const char *filename, const char *operator_i
     fclose(file);
 }
 
-// Helper for sending all bytes
-static int sendall_fd(int sock, const char *buf, size_t len) {
-    size_t total = 0;
-    int retry_count = 0;
-    const int MAX_RETRIES = 3;
-    
-    while (total < len) {
-        ssize_t n = send(sock, buf + total, len - total, 0);
-        
-        if (n > 0) {
-            total += n;
-            retry_count = 0;
-        } else if (n == 0) {
-            return -1;
-        } else {
-            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
-                retry_count++;
-                if (retry_count > MAX_RETRIES) {
-                    return -1;
-                }
-                usleep(1000);
-                continue;
-            }
-            return -1;
+// Lines of IOSB.txt shown before the download
+static int preview_lines(void) {
+    const char *env = getenv(IOSB_PREVIEW_ENV);
+    if (!env || !*env) return IOSB_PREVIEW_LINES;
+    int lines = atoi(env);
+    return lines > 0 ? lines : 0;
+}
+
+// Send the first max_lines lines of the report in a few large writes; the
+// complete file follows as the download. Returns -1 if the client is gone.
+static int send_preview(int client_fd, FILE *file, int max_lines) {
+    char block[16384];
+    char line[MAX_LINE];
+    int count = 0;
+
+    size_t used = (size_t)snprintf(block, sizeof(block), "=== Interoperator Billing File Content ===\n");
+    while (count < max_lines && fgets(line, sizeof(line), file)) {
+        size_t len = strlen(line);
+        if (used + len > sizeof(block)) {
+            if (send_all(client_fd, block, used) != 0) return -1;
+            used = 0;
         }
+        memcpy(block + used, line, len);
+        used += len;
+        count++;
+    }
+
+    const char *footer = "=== End of File ===\n";
+    char note[128];
+    if (count == max_lines && fgets(line, sizeof(line), file)) {
+        snprintf(note, sizeof(note), "=== First %d lines shown, the full report follows as IOSB.txt ===\n",
+                 max_lines);
+        footer = note;
+    }
+    size_t len = strlen(footer);
+    if (used + len > sizeof(block)) {
+        if (send_all(client_fd, block, used) != 0) return -1;
+        used = 0;
     }
-    return 0;
+    memcpy(block + used, footer, len);
+    used += len;
+    return send_all(client_fd, block, used);
 }
 
 void display_interoperator_billing_file(int client_fd, const char *filename) {
+    // IOSB.txt is generated from IOSB.col when missing or out of date
+    char column_path[512];
+    column_path_for(filename, column_path, sizeof(column_path));
+    if (colFileExportStale(column_path, filename))
+        export_iosb_text(column_path, filename);
+
     FILE *file = fopen(filename, "r");
-    char line[MAX_LINE];
-    int line_count = 0;
 
     if (!file) {
         char msg[512];
@@ -128,55 +244,15 @@ void display_interoperator_billing_file(int client_fd, const char *filename) {
         return;
     }
 
-    send_line_fd(client_fd, "=== Interoperator Billing File Content ===\n");
-
-    while (fgets(line, sizeof(line), file)) {
-        if (send_line_fd(client_fd, line) < 0) {
-            // Client disconnected
-            fclose(file);
-            return;
-        }
-        
-        line_count++;
-        // Add a small delay every 10 lines to prevent socket buffer overflow
-        if (line_count % 10 == 0) {
-            usleep(10000); // 10ms delay
-        }
-    }
-
-    send_line_fd(client_fd, "=== End of File ===\n");
-    fclose(file);
-    
-    // Now send the file transfer marker and transfer the file
-    send_line_fd(client_fd, "FILE_TRANSFER_START:IOSB.txt\n");
-    
-    // Reopen file for binary transfer
-    file = fopen(filename, "rb");
-    if (!file) {
-        send_line_fd(client_fd, "FILE_TRANSFER_ERROR\n");
+    int max_lines = preview_lines();
+    if (max_lines > 0 && send_preview(client_fd, file, max_lines) != 0) {
+        // Client disconnected
+        fclose(file);
         return;
     }
-    
-    // Get file size
-    fseek(file, 0, SEEK_END);
-    long filesize = ftell(file);
-    rewind(file);
-    
-    // Send file size
-    char size_msg[64];
-    snprintf(size_msg, sizeof(size_msg), "FILE_SIZE:%ld\n", filesize);
-    send_line_fd(client_fd, size_msg);
-    
-    // Send file data in chunks
-    char buffer[8192];
-    size_t bytes_read;
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
-        if (sendall_fd(client_fd, buffer, bytes_read) != 0) {
-            fclose(file);
-            return;
-        }
-    }
-    
+
+    // Now transfer the file straight from the page cache
+    if (send_file_transfer(client_fd, fileno(file), "IOSB.txt") != 0)
+        LOG_WARN("IOSB.txt download to client fd %d failed partway", client_fd);
     fclose(file);
-    send_line_fd(client_fd, "FILE_TRANSFER_COMPLETE\n");
 }
@@ -0,0 +1,67 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+/* ============================================================
+   Constants
+   ============================================================ */
+#define ARENA_BLOCK_SIZE (64 * 1024) // default block size
+#define ARENA_ALIGN 16
+
+/* ============================================================
+   Data Structures
+   ============================================================ */
+
+// One large allocation that records are bump-allocated from. data starts
+// on an ARENA_ALIGN boundary (malloc aligns the block itself as strictly).
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used;            // always a multiple of ARENA_ALIGN
+    size_t size;
+    _Alignas(ARENA_ALIGN) char data[];
+} ArenaBlock;
+
+// Interned string entry (open-addressing index over arena strings)
+typedef struct {
+    unsigned long hash;
+    const char *str;   // NUL-terminated copy inside the arena
+    size_t len;
+} ArenaString;
+
+// Bump allocator: memory is only released all at once by arenaRelease.
+// A zeroed Arena is empty and valid. Not thread-safe; give each thread its
+// own arena and splice them together with arenaAdopt.
+typedef struct {
+    ArenaBlock *head;       // current block (older blocks follow via next)
+    ArenaString *strings;   // intern index, power-of-two capacity
+    size_t stringCap;
+    size_t stringCount;
+} Arena;
+
+/* ============================================================
+   Function Declarations
+   ============================================================ */
+
+// Zeroed, ARENA_ALIGN-aligned memory; NULL on allocation failure
+void* arenaAlloc(Arena *arena, size_t size);
+
+// NUL-terminated copy of a (not necessarily terminated) string view
+char* arenaStrndup(Arena *arena, const char *s, size_t len);
+
+// Copy of the string, shared with earlier identical strings in this arena
+const char* arenaIntern(Arena *arena, const char *s, size_t len);
+
+// Move all of src's blocks into dst (pointers into src stay valid)
+void arenaAdopt(Arena *dst, Arena *src);
+
+// Bytes held by the arena's blocks and intern index
+size_t arenaBytes(const Arena *arena);
+
+// Free every block and the intern index
+void arenaRelease(Arena *arena);
+
+#endif // ARENA_H
@@ -0,0 +1,72 @@
+#ifndef CDRDECODE_H
+#define CDRDECODE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+/* ============================================================
+   Constants
+   ============================================================ */
+#define CDR_DECODE_SLOTS 4               // ring buffers between decoder thread and parser
+#define CDR_DECODE_CHUNK (1024 * 1024)   // decoded bytes per ring buffer
+#define CDR_DECODE_INPUT (256 * 1024)    // compressed bytes read per call
+
+/* ============================================================
+   Data Structures
+   ============================================================ */
+
+// Compression of an input, recognized by its magic bytes
+typedef enum {
+    CDR_CODEC_NONE = 0,
+    CDR_CODEC_GZIP,    // 1f 8b (decoded in-process with zlib)
+    CDR_CODEC_ZSTD     // 28 b5 2f fd (decoded by the zstd tool through a pipe)
+} CDRCodec;
+
+// Streaming decoder. A background thread decompresses the input into a
+// ring of CDR_DECODE_SLOTS buffers while the caller parses the ones already
+// filled, so decompression and parsing overlap. Buffers are handed out in
+// order by cdrDecoderNext and given back with cdrDecoderRelease.
+typedef struct {
+    int fd;                          // compressed input (not owned)
+    CDRCodec codec;
+    char *slots[CDR_DECODE_SLOTS];
+    size_t lens[CDR_DECODE_SLOTS];
+    int head;                        // next slot the decoder fills
+    int tail;                        // next slot the parser reads
+    int filled;                      // slots ready for the parser
+    int done;                        // decoder thread finished
+    int failed;                      // input was corrupt or could not be read
+    int stop;                        // parser closed the decoder early
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    pthread_t thread;
+    pid_t child;                     // external decompressor, 0 if none
+    int childOut;                    // its output pipe, -1 if none
+} CDRDecoder;
+
+/* ============================================================
+   Function Declarations
+   ============================================================ */
+
+// Codec of the file open on fd, from its first bytes (CDR_CODEC_NONE for
+// plain text and for inputs that cannot be read at an offset, e.g. pipes)
+CDRCodec cdrDetectCodec(int fd);
+const char* cdrCodecName(CDRCodec codec);
+
+// Start decoding fd. Returns NULL if the decoder cannot be started.
+CDRDecoder* cdrDecoderOpen(int fd, CDRCodec codec);
+
+// Next decoded buffer (*len bytes), or NULL once the input is exhausted.
+// The buffer stays valid until cdrDecoderRelease.
+const char* cdrDecoderNext(CDRDecoder *d, size_t *len);
+void cdrDecoderRelease(CDRDecoder *d);
+
+// Stop the decoder and free it. Returns 0 if the whole input decoded
+// cleanly, -1 if it was truncated or corrupt.
+int cdrDecoderClose(CDRDecoder *d);
+
+#endif // CDRDECODE_H
@@ -0,0 +1,154 @@
+#ifndef CDRREADER_H
+#define CDRREADER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+/* ============================================================
+   Constants
+   ============================================================ */
+#define CDR_INPUT_FILE "data/data.cdr"
+#define CDR_INPUT_ENV "CDR_INPUT"    // input file, directory or glob pattern (default CDR_INPUT_FILE)
+#define CDR_MAX_INPUT_FILES 4096
+#define CDR_FIELD_COUNT 9
+#define CDR_READ_CHUNK (1024 * 1024) // buffered fallback read size
+#define CDR_MAX_WORKERS 64
+#define CDR_MIN_SPLIT (256 * 1024)   // smallest byte range given to a worker
+#define CDR_SCAN_WHOLE_LINES 1       // scanCDRFileFrom: leave a trailing partial line unread
+#define CDR_WORKERS_ENV "CDR_WORKERS" // overrides the worker count
+#define CDR_FIXED_SCALE 1000          // volumes are fixed-point with 3 decimals
+
+/* ============================================================
+   Data Structures
+   ============================================================ */
+
+// Pointer + length view of one field; not NUL-terminated
+typedef struct {
+    const char *ptr;
+    size_t len;
+} CDRField;
+
+// Call type, decoded once per record (case-insensitive)
+typedef enum {
+    CDR_CALL_UNKNOWN = 0,
+    CDR_CALL_MOC,    // outgoing voice call
+    CDR_CALL_MTC,    // incoming voice call
+    CDR_CALL_SMS_MO, // outgoing SMS
+    CDR_CALL_SMS_MT, // incoming SMS
+    CDR_CALL_GPRS,   // data session
+    CDR_CALL_TYPE_COUNT
+} CDRCallType;
+
+// One CDR line, tokenized once and shared by every aggregator.
+// Field layout: MSISDN|OPERATOR|CODE|CALL_TYPE|DURATION|DOWNLOAD|UPLOAD|THIRD_MSISDN|THIRD_CODE
+typedef struct {
+    // Field views into the input buffer (missing fields have len 0)
+    CDRField fields[CDR_FIELD_COUNT];
+    int fieldCount;
+
+    // Call type; callTypeExact = 1 when spelled in upper case ("SMS-MO")
+    CDRCallType callType;
+    int callTypeExact;
+
+    // Typed values; typedValid = 1 when every one parsed as a complete number
+    int typedValid;
+    long msisdn;
+    int operatorCode;
+    long thirdPartyMsisdn;
+    int thirdPartyOpCode;
+
+    // Volumes in CDR_FIXED_SCALE units (e.g. "120.5" -> 120500). Always set:
+    // the field's numeric prefix, or 0 if it has none.
+    long long duration;
+    long long download;
+    long long upload;
+} CDRRecord;
+
+// Per-scan counters
+typedef struct {
+    long records;   // non-blank lines dispatched
+    long malformed; // of those, lines whose typed fields did not parse
+} CDRScanStats;
+
+// Files making up one processing run's input, in processing order
+typedef struct {
+    char **paths;
+    int count;
+} CDRInputSet;
+
+// Part of a regular input file covered by a scan
+typedef struct {
+    uint64_t dev, ino;     // identity of the file
+    uint64_t start;        // first byte scanned (a line start)
+    uint64_t end;          // file size when the scan began; bytes appended later are not scanned
+    int complete;          // the scan ended on a newline (or scanned nothing), so it can be
+                           // resumed at `end` without splitting a record
+} CDRInputInfo;
+
+// Aggregator callback invoked once per parsed record
+typedef void (*CDRConsumeFn)(const CDRRecord *rec, void *ctx);
+
+typedef struct {
+    const char *name;
+    CDRConsumeFn consume;
+    void *ctx;
+} CDRAggregator;
+
+/* ============================================================
+   Function Declarations
+   ============================================================ */
+
+// Tokenize one line (without its '\n') into field views and decode the
+// typed fields in place. Never reads past line + len.
+// Returns 1 for a record, 0 for a blank line.
+int parseCDRLine(const char *line, size_t len, CDRRecord *rec);
+
+// Call type of a field (CDR_CALL_UNKNOWN if unrecognized); *exact reports
+// whether it matched the canonical upper-case spelling
+CDRCallType cdrCallType(CDRField f, int *exact);
+
+// Read the CDR file once and feed every record to all aggregators.
+// Regular files are mmap'd and parsed in place; pipes and other
+// non-regular inputs fall back to large buffered reads.
+// Returns the number of records dispatched, or -1 if the file cannot be read.
+// stats (optional) receives the record and malformed-line counts.
+long scanCDRFile(const char *filename, const CDRAggregator *aggs, int aggCount,
+                 CDRScanStats *stats);
+
+// Parallel scan of a regular file from byte `start` (0 or just after a
+// newline) to its current end; used to resume after a checkpoint and to
+// follow a growing file. The window is split into newline-aligned byte
+// ranges and worker w feeds its own aggregator set
+// aggs[w * aggCount .. w * aggCount + aggCount - 1]; ranges are assigned in
+// file order, so merging worker results 0..workers-1 reproduces the
+// sequential order. With CDR_SCAN_WHOLE_LINES in flags the scan stops
+// after the last newline, so a line still being appended is read by a later
+// scan. info (optional) receives the scanned window. Returns -1, before
+// feeding any aggregator, if the file cannot be opened or mapped, is not a
+// regular file or is shorter than start.
+long scanCDRFileFrom(const char *filename, uint64_t start, int flags,
+                     const CDRAggregator *aggs, int aggCount, int workers,
+                     CDRScanStats *stats, CDRInputInfo *info);
+
+// Input selection: $CDR_INPUT if set, else CDR_INPUT_FILE. cdrInputSetOpen
+// expands a directory to the regular files in it and a glob pattern to its
+// matches, both sorted by name (hourly rotated files come out in time
+// order); any other spec is a single file. Returns 0 on success (count may
+// be 0), -1 on error; release with cdrInputSetFree.
+const char* cdrInputSpec(void);
+int cdrInputSetOpen(const char *spec, CDRInputSet *set);
+void cdrInputSetFree(CDRInputSet *set);
+
+// 1 if the file is stored compressed (gzip or zstd, recognized by its magic
+// bytes whatever its name). Compressed inputs are
+// decoded as a stream by scanCDRFile; they cannot be split or resumed, so
+// scanCDRFileFrom rejects them.
+int cdrInputCompressed(const char *filename);
+
+// Worker count: $CDR_WORKERS if set, else online CPUs (1..CDR_MAX_WORKERS)
+int cdrWorkerCount(void);
+
+#endif // CDRREADER_H
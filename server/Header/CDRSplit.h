@@ -0,0 +1,26 @@
+#ifndef CDRSPLIT_H
+#define CDRSPLIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* ============================================================
+   Constants
+   ============================================================ */
+#define CDR_SPLIT_BLOCK 16384 // bytes indexed per call (offsets fit in uint16_t)
+
+/* ============================================================
+   Function Declarations
+   ============================================================ */
+
+// Find every '|', '\r' and '\n' in data[0 .. len) and store their offsets in
+// ascending order. len must not exceed CDR_SPLIT_BLOCK; pos needs room for len
+// entries. Returns the number of offsets stored.
+// Scans 32 bytes at a time with AVX2 when the CPU supports it, 16 with SSE2
+// otherwise, and falls back to a byte loop on other architectures.
+size_t cdrFindDelims(const char *data, size_t len, uint16_t *pos);
+
+// Name of the scanner selected at runtime ("avx2", "sse2" or "scalar")
+const char* cdrSplitImpl(void);
+
+#endif // CDRSPLIT_H
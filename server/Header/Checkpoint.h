@@ -0,0 +1,62 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "CDRReader.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+#define CKPT_FILE "CDR.ckpt"          // written next to CB.col / IOSB.col
+#define CKPT_MAGIC "CDRK"
+#define CKPT_VERSION 1
+#define CKPT_SAMPLE 4096              // input bytes hashed at the start and before the offset
+#define CKPT_ENV "CDR_INCREMENTAL"    // "0" always processes the whole input
+
+/* ============================================================
+   Data Structures
+   ============================================================ */
+
+// Progress of the last run for one output directory. The aggregated state
+// itself is the CB.col / IOSB.col pair written by that run; the checkpoint
+// records which input bytes it covers and which result files hold it, so
+// the next run only has to scan what was appended since.
+typedef struct {
+    char magic[4];            // CKPT_MAGIC
+    uint32_t version;         // CKPT_VERSION
+    uint64_t inputDev;        // identity of the input file
+    uint64_t inputIno;
+    uint64_t offset;          // input bytes aggregated (ends on a newline)
+    uint64_t headHash;        // FNV-1a of the first CKPT_SAMPLE bytes below offset
+    uint64_t tailHash;        // FNV-1a of the CKPT_SAMPLE bytes before offset
+    int64_t records;          // records aggregated up to offset
+    int64_t malformed;
+    uint64_t cbIno, cbSize;   // CB.col written from this state
+    uint64_t iosbIno, iosbSize; // IOSB.col written from this state
+} CDRCheckpoint;
+
+/* ============================================================
+   Function Declarations
+   ============================================================ */
+
+// 1 unless $CDR_INCREMENTAL is "0"
+int checkpointEnabled(void);
+
+// Load output_dir's checkpoint and check that it still applies: the input is
+// the same file, still holds the checkpointed bytes unchanged, and CB.col /
+// IOSB.col are the files written with it. Returns 0 if it can be resumed.
+int loadCheckpoint(const char *output_dir, const char *input_path, CDRCheckpoint *ckpt);
+
+// Record that the result files now in output_dir aggregate the input up to
+// the end of the scan described by info (which must be complete). Returns 0
+// on success.
+int saveCheckpoint(const char *output_dir, const char *input_path,
+                   const CDRInputInfo *info, long records, long malformed);
+
+// Forget the checkpoint (the next run processes the whole input)
+void removeCheckpoint(const char *output_dir);
+
+#endif // CHECKPOINT_H
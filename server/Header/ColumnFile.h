@@ -0,0 +1,122 @@
+#ifndef COLUMNFILE_H
+#define COLUMNFILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* ============================================================
+   Constants
+   ============================================================ */
+#define COLFILE_MAGIC "CDRC"
+#define COLFILE_VERSION 1
+#define COLFILE_ALIGN 64        // column data starts on a cache line (SIMD friendly)
+#define COLFILE_NAME_MAX 24
+#define COLFILE_KIND_MAX 8
+#define COLFILE_MAX_COLUMNS 32
+#define COLFILE_SORTED_ENV "CDR_SORTED_OUTPUT" // "0" keeps rows in hash table order
+#define COLFILE_FLAG_SORTED 1   // column values are strictly ascending
+
+/* ============================================================
+   On-Disk Layout
+   ============================================================
+   [ColFileHeader][ColumnDesc x columnCount][pad][column 0][pad][column 1]...
+
+   INT64 / INT32 columns are plain arrays of `rows` values. A STRING column
+   is `rows + 1` uint64 offsets into the bytes that follow them; every string
+   is stored NUL-terminated. Integers are in host byte order. */
+
+typedef enum {
+    COL_INT64 = 1,
+    COL_INT32 = 2,
+    COL_STRING = 3
+} ColType;
+
+typedef struct {
+    char magic[4];                 // COLFILE_MAGIC
+    uint32_t version;              // COLFILE_VERSION
+    char kind[COLFILE_KIND_MAX];   // table stored in the file ("CB", "IOSB")
+    uint64_t rowCount;             // rows of the main table
+    uint32_t columnCount;
+    uint32_t fixedScale;           // units of fixed-point columns (CDR_FIXED_SCALE)
+} ColFileHeader;
+
+typedef struct {
+    char name[COLFILE_NAME_MAX];
+    uint32_t type;                 // ColType
+    uint32_t flags;                // COLFILE_FLAG_*
+    uint64_t rows;                 // may differ from rowCount (dictionaries)
+    uint64_t offset;               // from the start of the file
+    uint64_t size;                 // bytes
+} ColumnDesc;
+
+// Streaming writer: columns are written one after the other, then the
+// header and directory are filled in and the file is renamed into place.
+typedef struct {
+    FILE *fp;
+    char path[512];
+    char tmpPath[560];
+    ColFileHeader header;
+    ColumnDesc columns[COLFILE_MAX_COLUMNS];
+    int declared;                  // columns announced in colWriterOpen
+    uint64_t pos;                  // current file offset
+    int failed;
+} ColFileWriter;
+
+// Read-only mapped file
+typedef struct {
+    void *map;
+    size_t size;
+    const ColFileHeader *header;
+    const ColumnDesc *columns;
+    dev_t dev;                     // identity of the file that was mapped
+    ino_t ino;
+} ColFile;
+
+/* ============================================================
+   Function Declarations
+   ============================================================ */
+
+// 1 if result files are written sorted by key (the default), 0 if
+// $CDR_SORTED_OUTPUT is "0"
+int colSortedOutput(void);
+
+// Writer. Returns 0 on success, -1 on error (colWriterClose discards the file).
+int colWriterOpen(ColFileWriter *w, const char *path, const char *kind,
+                  uint64_t rowCount, int columnCount, uint32_t fixedScale);
+int colWriterBegin(ColFileWriter *w, const char *name, ColType type, uint64_t rows);
+int colWriterPut(ColFileWriter *w, const void *data, size_t bytes);
+int colWriterEnd(ColFileWriter *w);
+void colWriterSetFlags(ColFileWriter *w, uint32_t flags); // column being written
+int colWriterClose(ColFileWriter *w);
+
+// Append all values of a string column (offsets then bytes)
+int colWriterStrings(ColFileWriter *w, const char *name,
+                     const char *const *strings, uint64_t rows);
+
+// Reader. colFileOpen maps and validates the file; returns 0 on success.
+int colFileOpen(ColFile *f, const char *path, const char *kind);
+void colFileClose(ColFile *f);
+
+// 1 if path still names the file that f mapped (it was not replaced since)
+int colFileIsCurrent(const ColFile *f, const char *path);
+
+// 1 if columnPath exists and the export generated from it (exportPath) is
+// missing or older, i.e. the export must be regenerated
+int colFileExportStale(const char *columnPath, const char *exportPath);
+
+// Row count of a column, or -1 if the file has no such column
+int64_t colFileRows(const ColFile *f, const char *name);
+
+// Flags of a column (0 if absent)
+uint32_t colFileFlags(const ColFile *f, const char *name);
+
+// Column data if present with the given type and row count, else NULL
+const void* colFileColumn(const ColFile *f, const char *name, ColType type, uint64_t rows);
+
+// String i of a STRING column returned by colFileColumn
+const char* colFileString(const void *column, uint64_t rows, uint64_t i);
+
+#endif // COLUMNFILE_H
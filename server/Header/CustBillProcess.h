@@ -6,11 +6,30 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include "CDRReader.h"
+#include "Arena.h"
+#include "ColumnFile.h"
+#include "ReportWriter.h"
 
 /* ============================================================
    Constants
    ============================================================ */
-#define HASH_SIZE 1000
+#define CUST_TABLE_MIN_CAPACITY 1024 // slots allocated on first insert (power of two)
+#define CUST_TABLE_MAX_LOAD 70       // grow when more than 70% of slots are used
+#define CUST_EMPTY_KEY LONG_MIN      // marks a free slot; not a valid MSISDN
+#define CUST_NAME_MAX 63             // operator names are truncated to this length
+
+#define CB_COLUMN_FILE "CB.col"      // columnar customer results (primary output)
+#define CB_COLUMN_KIND "CB"
+#define CB_METRIC_COUNT 10           // counter columns after msisdn/operator/code
+#define CB_INDEX_FILE "CB.idx"       // MSISDN index written next to CB.txt
+#define CB_INDEX_MAGIC "CBIX"
+#define CB_INDEX_VERSION 1
+#define CB_RECORD_LINES 12           // lines of a CB.txt record sent by search_msisdn
+#define CB_RECORD_MAX 1024           // upper bound of one formatted CB.txt record
+#define CB_EXPORT_MIN_ROWS 65536     // smallest row range formatted by one export worker
 
 /* ============================================================
    Data Structures
@@ -19,54 +38,120 @@
 // Customer structure for billing
 typedef struct Customer {
     long msisdn;
-    char operatorName[64];
+    const char *operatorName; // interned in the owning table's arena
     int operatorCode;
     
-    // Voice call durations (within and outside operator)
-    float inVoiceWithin;
-    float outVoiceWithin;
-    float inVoiceOutside;
-    float outVoiceOutside;
+    // Voice call durations (within and outside operator), CDR_FIXED_SCALE units
+    long long inVoiceWithin;
+    long long outVoiceWithin;
+    long long inVoiceOutside;
+    long long outVoiceOutside;
     
     // SMS counts
-    int smsInWithin;
-    int smsOutWithin;
-    int smsInOutside;
-    int smsOutOutside;
-    
-    // Data usage
-    float mbDownload;
-    float mbUpload;
+    long smsInWithin;
+    long smsOutWithin;
+    long smsInOutside;
+    long smsOutOutside;
     
-    struct Customer *next; // for hash collision chaining
+    // Data usage in CDR_FIXED_SCALE units (1/1000 MB)
+    long long mbDownload;
+    long long mbUpload;
 } Customer;
 
-// Thread argument structure for passing output directory
+// Open-addressing (linear probing) customer table keyed by MSISDN.
+// Keys are probed in their own dense array; the matching Customer record
+// is stored inline in the parallel slot array. A zeroed table is empty and
+// valid. Each scan worker fills a private table that is merged into the
+// job's table once scanning finishes.
+typedef struct {
+    long *keys;         // MSISDN per slot, CUST_EMPTY_KEY when free
+    Customer *slots;    // records, parallel to keys
+    size_t capacity;    // power of two (0 until first insert)
+    size_t count;       // occupied slots
+    long totalRecords;
+    Arena arena;        // interned operator names
+} CustomerTable;
+
+// CB.idx layout: one header followed by `capacity` entries forming an
+// open-addressing table probed exactly like CustomerTable (hashFunction,
+// linear probing, msisdn == CUST_EMPTY_KEY marks a free entry). Each entry
+// locates one record of CB.txt, so a lookup is a few preads instead of a
+// scan of the whole report. Fields are in host byte order.
+typedef struct {
+    char magic[4];        // CB_INDEX_MAGIC
+    uint32_t version;     // CB_INDEX_VERSION
+    uint64_t capacity;    // entry count (power of two)
+    uint64_t count;       // customers indexed
+    uint64_t reportSize;  // size of the CB.txt this index was written for
+} CBIndexHeader;
+
 typedef struct {
-    char output_dir[256];
-} ProcessThreadArg;
+    int64_t msisdn;
+    uint64_t offset;      // start of the "Customer ID:" line in CB.txt
+    uint32_t length;      // bytes up to and including the separator line
+    uint32_t reserved;
+} CBIndexEntry;
+
+// Mapped CB.col. Columns: msisdn (INT64), operator (INT32 index into the
+// operator_names dictionary), operator_code (INT32) and the counters
+// in_voice_within .. mb_upload (INT64, CDR_FIXED_SCALE units for volumes).
+// Rows are in ascending MSISDN order unless sorted output was turned off
+// ($CDR_SORTED_OUTPUT=0), in which case they follow the hash table.
+typedef struct {
+    ColFile file;
+    uint64_t rows;
+    const int64_t *msisdn;
+    const int32_t *operatorIndex;
+    const int32_t *operatorCode;
+    const int64_t *metrics[CB_METRIC_COUNT];
+    const void *operatorNames;
+    uint64_t operatorCount;
+    int sorted;                 // msisdn marked COLFILE_FLAG_SORTED: binary search
+} CBColumns;
 
 /* ============================================================
    Function Declarations
    ============================================================ */
 
-// Thread entry point
+// Thread entry point (arg is a BillingJob): writes CB.col from the job's table
 void* custbillprocess(void *arg);
 
 // Search and display functions
 void search_msisdn(int client_fd, const char *filename, long msisdn);
 void display_customer_billing_file(int client_fd, const char *filename);
 
-// Customer processing functions
-Customer* createCustomer(long msisdn, const char *operatorName, int operatorCode);
-Customer* getCustomer(long msisdn, const char *operatorName, int operatorCode);
+// Customer processing functions. The returned pointer is valid until the
+// next insert into the same table (inserts may grow the slot array).
+Customer* getCustomer(CustomerTable *table, long msisdn, const char *operatorName,
+                      size_t nameLen, int operatorCode);
+Customer* findCustomer(const CustomerTable *table, long msisdn);
+
+// CDR processing functions (ctx is the CustomerTable to fill)
+void customerConsumeRecord(const CDRRecord *rec, void *ctx);
+// Emit one CB.txt record (leading blank line through the separator)
+void emitCustomerRecord(ReportWriter *w, const Customer *cust);
+// Same record into buf; returns the length like snprintf
+int formatCustomerRecord(char *buf, size_t size, const Customer *cust);
+
+// Columnar output: CB.col is written by processing; CB.txt and CB.idx are
+// generated from it on demand. Return 0 on success, -1 on error.
+int writeCBColumns(const CustomerTable *table, const char *columnFile);
+int exportCBText(const char *columnFile, const char *outputFile, const char *indexFile);
+
+// Read access to CB.col
+int openCBColumns(CBColumns *cols, const char *columnFile);
+void closeCBColumns(CBColumns *cols);
+int64_t findCBColumnRow(const CBColumns *cols, long msisdn); // row or -1
+int loadCBColumnRow(const CBColumns *cols, uint64_t row, Customer *cust); // -1 if corrupt
+// Add every row of CB.col to table (resuming from a checkpoint)
+int loadCBColumnsInto(CustomerTable *table, const char *columnFile);
 
-// CDR processing functions
-void processCDRFile(const char *filename);
-void writeCBFile(const char *outputFile);
-void cleanupHashTable(void);
+// Table management
+void mergeCustomerTable(CustomerTable *dst, CustomerTable *src); // moves src records into dst
+int copyCustomerTable(CustomerTable *dst, const CustomerTable *src); // replaces dst; -1 on failure
+void freeCustomerTable(CustomerTable *table);
 
-// Hash function
-unsigned int hashFunction(long key);
+// Hash function (64-bit integer mix of the MSISDN)
+unsigned long hashFunction(long key);
 
 #endif // CUSTBILLPROCESS_H
@@ -0,0 +1,38 @@
+#ifndef FILETRANSFER_H
+#define FILETRANSFER_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+/* ============================================================
+   Constants
+   ============================================================ */
+#define TRANSFER_WAIT_MS 60000          // give up when the client takes nothing for this long
+#define TRANSFER_COPY_CHUNK (64 * 1024) // read/send fallback when sendfile is unsupported
+
+/* ============================================================
+   Function Declarations
+   ============================================================ */
+
+// Send the file open on file_fd as a FILE_TRANSFER block:
+//   FILE_TRANSFER_START:<name>\n FILE_SIZE:<bytes>\n <bytes> FILE_TRANSFER_COMPLETE\n
+// The body goes from the page cache to the socket with sendfile(), resuming
+// after partial sends and waiting for writability (poll) when the socket is
+// non-blocking or its send timeout expires. Returns 0, or -1 if the client
+// went away or the file could not be read (nothing more should be sent).
+int send_file_transfer(int sock, int file_fd, const char *name);
+
+// Send len bytes from buf, resuming after partial sends and interrupted
+// calls and waiting for writability when the socket is full. Returns 0, or
+// -1 if the client went away.
+int send_all(int sock, const char *buf, size_t len);
+
+// Send len bytes of file_fd starting at offset; same waiting rules
+int sendfile_all(int sock, int file_fd, off_t offset, size_t len);
+
+// Wait until the socket can take more data (flow control for sends that
+// returned EAGAIN). Returns 0 when writable, -1 on error or after
+// TRANSFER_WAIT_MS without progress.
+int wait_writable(int sock);
+
+#endif // FILETRANSFER_H
@@ -6,11 +6,21 @@
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
+#include "CDRReader.h"
+#include "Arena.h"
+#include "ColumnFile.h"
+#include "ReportWriter.h"
 
 /* ============================================================
    Constants
    ============================================================ */
 #define NUM_BUCKETS 4096
+#define IOSB_RECORD_MAX 1024 // typical upper bound of one formatted IOSB.txt record
+#define IOSB_COLUMN_FILE "IOSB.col" // columnar operator results (primary output)
+#define IOSB_COLUMN_KIND "IOSB"
+#define IOSB_METRIC_COUNT 6         // counter columns after operator_id/operator_name
+#define IOSB_PREVIEW_LINES 100      // IOSB.txt lines shown before the download
+#define IOSB_PREVIEW_ENV "IOSB_PREVIEW_LINES" // overrides the preview length (0 disables it)
 
 /* ============================================================
    Data Structures
@@ -19,12 +29,12 @@
 typedef struct OperatorStats
 {
     char *operator_name;     // first seen operator name, this value is also unique.
-    long total_moc_duration; // Mobile Originated Call duration (Outgoing)
-    long total_mtc_duration; // Mobile Terminated Call duration (Incoming)
-    long sms_mo_count;       // SMS Mobile Originated (Outgoing) Count
-    long sms_mt_count;       // SMS Mobile Terminated (Incoming) Count
-    long total_download;     // MB Downloaded
-    long total_upload;       // MB Uploaded
+    long long total_moc_duration; // Mobile Originated Call duration (Outgoing), fixed-point
+    long long total_mtc_duration; // Mobile Terminated Call duration (Incoming), fixed-point
+    long sms_mo_count;            // SMS Mobile Originated (Outgoing) Count
+    long sms_mt_count;            // SMS Mobile Terminated (Incoming) Count
+    long long total_download;     // MB Downloaded, fixed-point
+    long long total_upload;       // MB Uploaded, fixed-point
 } OperatorStats;
 
 typedef struct OpNode
@@ -34,30 +44,70 @@ typedef struct OpNode
     struct OpNode *next; // Chaining (linked list)
 } OpNode;
 
+// Operator hash map. Each scan worker fills a private table that is
+// merged into the job's table once scanning finishes.
+typedef struct
+{
+    OpNode *buckets[NUM_BUCKETS];
+    Arena arena; // nodes, operator ids and interned operator names
+} OperatorTable;
+
+// Mapped IOSB.col. Columns: operator_id and operator_name (STRING) and the
+// counters mtc_duration .. upload (INT64, CDR_FIXED_SCALE units for volumes),
+// one row per operator in IOSB.txt order.
+typedef struct
+{
+    ColFile file;
+    uint64_t rows;
+    const void *operator_id;
+    const void *operator_name;
+    const int64_t *metrics[IOSB_METRIC_COUNT];
+} IOSBColumns;
+
 /* ============================================================
    Function Declarations
    ============================================================ */
 
-// Thread entry point
+// Thread entry point (arg is a BillingJob): writes IOSB.col from the job's table
 void* intopbillprocess(void *arg);
 
-// Main processing function
-void InteroperatorBillingProcess(const char *input_path, const char *output_path);
+// Emit one IOSB.txt record (brand line through the separator)
+void emit_operator_record(ReportWriter *w, const OpNode *node);
+// Same record into buf; returns the length like snprintf
+int format_operator_record(char *buf, size_t size, const OpNode *node);
+
+// Columnar output: IOSB.col is written by processing; IOSB.txt is generated
+// from it on demand. Return 0 on success, -1 on error.
+int write_iosb_columns(const OperatorTable *table, const char *column_path);
+int export_iosb_text(const char *column_path, const char *output_path);
+
+// Read access to IOSB.col. load_iosb_column_row fills a node whose strings
+// point into the mapped file.
+int open_iosb_columns(IOSBColumns *cols, const char *column_path);
+void close_iosb_columns(IOSBColumns *cols);
+void load_iosb_column_row(const IOSBColumns *cols, uint64_t row, OpNode *node);
+// Add every row of IOSB.col to table (resuming from a checkpoint)
+int load_iosb_columns_into(OperatorTable *table, const char *column_path);
+
+// Operators in report order: ascending operator_id, or bucket order when
+// sorted output is off ($CDR_SORTED_OUTPUT=0). The caller frees the array;
+// NULL on allocation failure.
+const OpNode** list_operators(const OperatorTable *table, size_t *count);
+
+// Table management
+void merge_operator_table(OperatorTable *dst, OperatorTable *src); // moves src nodes into dst
+int copy_operator_table(OperatorTable *dst, const OperatorTable *src); // replaces dst; -1 on failure
+void free_operator_table(OperatorTable *table);
 
 // Search and display functions
 void search_operator(int client_fd, const char *filename, const char *operator_name);
 void display_interoperator_billing_file(int client_fd, const char *filename);
 
 // Hash map operations
-unsigned long str_hash(const char *s);
-OpNode* get_or_create_opnode(const char *operator_id, const char *operator_name);
-
-// Utility functions
-void chomp(char *s);
-int split_pipe(char *line, char **tokens, int max_tokens);
-long to_long_or_zero(const char *s);
+OpNode* get_or_create_opnode(OperatorTable *table, const char *operator_id,
+                             const char *operator_name);
 
-// Line processing
-void process_line(char *line);
+// Line processing (ctx is the OperatorTable to fill)
+void operatorConsumeRecord(const CDRRecord *rec, void *ctx);
 
 #endif // INTOPBILLPROCESS_H
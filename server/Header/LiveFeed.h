@@ -0,0 +1,41 @@
+#ifndef LIVEFEED_H
+#define LIVEFEED_H
+
+#include <stdint.h>
+#include "process.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+#define LIVE_FEED_ENV "CDR_FOLLOW"             // "1" follows the CDR input file
+#define LIVE_REFRESH_ENV "CDR_FOLLOW_REFRESH"  // seconds between report refreshes (0: on request only)
+#define LIVE_REFRESH_DEFAULT 60
+#define LIVE_POLL_MS 5000                      // re-check the input even without inotify events
+#define LIVE_MAX_DIRS 16                       // output directories refreshed on the timer
+
+/* ============================================================
+   Function Declarations
+   ============================================================ */
+
+// Follow mode: a background thread scans the input once, then watches it
+// (inotify, with a periodic check as fallback) and merges every newly
+// appended complete line into resident customer and operator aggregates.
+// A rotated or truncated input is rescanned from the start.
+//
+// liveFeedStart starts the follower if $CDR_FOLLOW is "1"; returns 1 if
+// following, 0 if follow mode is off, -1 if the thread cannot be started.
+int liveFeedStart(const char *input_path);
+void liveFeedStop(void);
+int liveFeedActive(void);
+
+// Catch up with the input, then copy the aggregates, counts and scanned
+// window into job (whose tables must be empty). *generation (optional)
+// identifies the copied state. Returns 0, or -1 if nothing could be read.
+int liveFeedCopy(BillingJob *job, uint64_t *generation);
+
+// Rewrite output_dir's results from the aggregates every
+// $CDR_FOLLOW_REFRESH seconds while they change; generation is the state
+// the directory was last written from
+void liveFeedRegister(const char *output_dir, uint64_t generation);
+
+#endif // LIVEFEED_H
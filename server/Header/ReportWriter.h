@@ -0,0 +1,71 @@
+#ifndef REPORTWRITER_H
+#define REPORTWRITER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* ============================================================
+   Constants
+   ============================================================ */
+#define REPORT_BUFFER_SIZE (1 << 20) // bytes collected before each write() to the file
+
+/* ============================================================
+   Data Structures
+   ============================================================ */
+
+// Buffered text emitter for the billing reports. Values are converted by
+// hand straight into a private buffer that is flushed with write() in
+// large blocks, bypassing stdio's format parsing and stream lock.
+//
+// A writer either targets a file descriptor or formats into a caller's
+// buffer (reportWriterInitBuffer). reportWriterOpenAt pwrites from a given
+// offset, so several writers can fill disjoint parts of one file. In buffer
+// mode output that does not fit is dropped but still counted, so `offset`
+// is the length the text needs, like snprintf's result.
+typedef struct {
+    int fd;             // -1 in buffer mode
+    int64_t filePos;    // next pwrite offset, -1 to write() at the fd's offset
+    char *buf;
+    size_t len;         // bytes pending in buf
+    size_t cap;
+    uint64_t offset;    // bytes emitted so far (flushed + pending)
+    int owned;          // buf was allocated by reportWriterOpen
+    int failed;         // a write() failed (file mode)
+} ReportWriter;
+
+/* ============================================================
+   Function Declarations
+   ============================================================ */
+
+// File mode: returns 0 on success, -1 if the buffer cannot be allocated.
+// reportWriterClose flushes, frees the buffer and returns 0 if every byte
+// was written; it does not close fd.
+int reportWriterOpen(ReportWriter *w, int fd);
+int reportWriterOpenAt(ReportWriter *w, int fd, uint64_t offset);
+int reportWriterClose(ReportWriter *w);
+
+// Buffer mode: formats into buf (NUL-terminated when it fits). With a NULL
+// buf and size 0 the writer only measures the text.
+void reportWriterInitBuffer(ReportWriter *w, char *buf, size_t size);
+void reportWriterFinishBuffer(ReportWriter *w);
+
+int reportFlush(ReportWriter *w);
+
+// Emitters
+void reportPutBytes(ReportWriter *w, const char *s, size_t n);
+void reportPutStr(ReportWriter *w, const char *s);
+void reportPutLong(ReportWriter *w, long value);
+// Fixed-point value in CDR_FIXED_SCALE units, rounded half away from zero
+// to `decimals` (0-3) places
+void reportPutFixed(ReportWriter *w, long long value, int decimals);
+
+// Length of the text reportPutLong / reportPutFixed emit for a value,
+// without formatting it
+size_t reportLongLength(long value);
+size_t reportFixedLength(long long value, int decimals);
+
+#define reportPutLit(w, lit) reportPutBytes((w), (lit), sizeof(lit) - 1)
+
+#endif // REPORTWRITER_H
@@ -0,0 +1,56 @@
+#ifndef RESULTSTORE_H
+#define RESULTSTORE_H
+
+#include <pthread.h>
+#include "CustBillProcess.h"
+#include "IntopBillProcess.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+#define RESULT_STORE_MAX_SNAPSHOTS 16           // output directories kept resident
+#define RESULT_STORE_MAX_MB 1024                // default memory cap for all snapshots
+#define RESULT_STORE_MB_ENV "CDR_RESULT_CACHE_MB" // overrides the memory cap (0 disables)
+
+/* ============================================================
+   Data Structures
+   ============================================================ */
+
+// Aggregated results of the latest processing run for one output directory.
+// Snapshots are read-only once published; readers hold a reference from
+// resultStoreAcquire until resultStoreRelease, so a snapshot replaced or
+// evicted while in use is freed only after its last reader lets go.
+typedef struct ResultSnapshot {
+    char output_dir[256];
+    CustomerTable customers;
+    OperatorTable operators;
+    long records;                        // records scanned for this run
+    size_t bytes;                        // memory held by the tables
+
+    // Store bookkeeping (guarded by the store lock)
+    int refs;                            // readers + 1 while listed in the store
+    struct ResultSnapshot *prev, *next;  // LRU list, most recently used first
+} ResultSnapshot;
+
+/* ============================================================
+   Function Declarations
+   ============================================================ */
+
+// Take ownership of the tables (they are left empty) and publish them as the
+// current snapshot of output_dir, replacing any previous one. Least recently
+// used snapshots are evicted to stay within the count and memory caps.
+void resultStorePublish(const char *output_dir, CustomerTable *customers,
+                        OperatorTable *operators, long records);
+
+// Remove the snapshot of output_dir, e.g. after its results could not be
+// saved (readers keep theirs until released)
+void resultStoreDrop(const char *output_dir);
+
+// Current snapshot of output_dir with a reference held, or NULL
+const ResultSnapshot* resultStoreAcquire(const char *output_dir);
+void resultStoreRelease(const ResultSnapshot *snap);
+
+// Snapshot of the directory holding a report file (e.g. "Output/u/CB.txt")
+const ResultSnapshot* resultStoreAcquireFor(const char *report_path);
+
+#endif // RESULTSTORE_H
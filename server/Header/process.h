@@ -17,14 +17,47 @@
    ============================================================ */
 #define BUFSIZE 1024
 
+/* ============================================================
+   Data Structures
+   ============================================================ */
+
+// State of one processing run. processCDRdata creates a job per request and
+// passes it down to the scan, merge and report stages, so several users can
+// process CDR data at the same time without sharing tables.
+typedef struct {
+    char output_dir[256];
+    CustomerTable customers; // merged customer aggregates
+    OperatorTable operators; // merged operator aggregates
+    long records;            // records aggregated (including a resumed checkpoint)
+    long malformed;          // records skipped by the customer report
+    char input_path[256];    // input file when the run read a single one, else ""
+    CDRInputInfo input;      // part of that file scanned by this run
+    int customerSaved;       // CB.col written by custbillprocess
+    int operatorSaved;       // IOSB.col written by intopbillprocess
+} BillingJob;
+
 /* ============================================================
    Function Declarations
    ============================================================ */
 
 // Socket communication helpers
-int sendall_fd(int sock, const char *buf, size_t len);
 int send_line_fd(int sock, const char *s);
 
+// Job lifecycle
+BillingJob* createBillingJob(const char *output_dir);
+void destroyBillingJob(BillingJob *job);
+
+// Processing stages. scanAndMerge scans the input from byte `start`
+// (scanCDRFileFrom flags) on `workers` threads and merges the partial tables
+// into the job's tables, after any state already there; returns records
+// scanned or -1. writeJobResults writes CB.col / IOSB.col on two threads,
+// saves the checkpoint and publishes the tables, then destroys the job;
+// returns 0 (after telling the client) if the writer threads could not be
+// started or either file could not be saved.
+long scanAndMerge(BillingJob *job, const char *input_path, uint64_t start, int flags,
+                  int workers);
+int writeJobResults(BillingJob *job, int client_fd);
+
 // Main CDR processing function
 int processCDRdata(int client_fd, const char *output_dir);
 
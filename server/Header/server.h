@@ -7,14 +7,22 @@
 #include <unistd.h>
 #include <errno.h>
 #include <signal.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <ctype.h>
 #include <pthread.h>
 #include "process.h"
+#include "CDRSplit.h"
+#include "LiveFeed.h"
+#include "Log.h"
 #include "auth.h"
 #include "CustBillProcess.h"
 #include "IntopBillProcess.h"
@@ -23,18 +31,30 @@
    Constants
    ============================================================ */
 #define PORT 12345
-#define BACKLOG 5
+#define BACKLOG 128
 #define BUFSIZE 1024
+#define READ_BUFSIZE 4096                   // bytes a LineReader receives ahead of the lines
+#define MAX_EVENTS 256                      // epoll events handled per wakeup
+#define WORKERS_ENV "SERVER_WORKERS"        // worker threads for CDR processing and file output
+#define WORKERS_DEFAULT 4
+#define MIN_WORKERS 2                       // one for CDR processing, one for everything else
+#define MAX_WORKERS 64
+#define TASK_QUEUE_MAX 1024                 // requests waiting for a worker
+#define SESSION_OUT_MAX (1024 * 1024)       // unsent output a session may accumulate
+#define SEND_TIMEOUT_SEC 60                 // a worker gives up on a client that stops reading
 
 /* ============================================================
    Data Structures
    ============================================================ */
 
-// Structure to pass client info to thread
+// Buffered line input from a socket: recv() fills the buffer in large reads
+// and complete lines are handed out from it, so the bytes of a line (and any
+// lines sent ahead) cost one syscall instead of one each
 typedef struct {
-    int client_fd;
-    struct sockaddr_in client_addr;
-} ClientInfo;
+    char data[READ_BUFSIZE];
+    size_t start;                   // first byte not handed out yet
+    size_t end;                     // end of the received bytes
+} LineReader;
 
 // Menu states
 typedef enum {
@@ -45,17 +65,67 @@ typedef enum {
     INTER_BILL
 } MenuState;
 
+// Input the session is waiting for within its menu
+typedef enum {
+    AWAIT_CHOICE,
+    AWAIT_SIGNUP_EMAIL,
+    AWAIT_SIGNUP_PASSWORD,
+    AWAIT_LOGIN_EMAIL,
+    AWAIT_LOGIN_PASSWORD,
+    AWAIT_MSISDN,
+    AWAIT_OPERATOR
+} InputStep;
+
+// Requests run on a worker thread instead of the event loop
+typedef enum {
+    TASK_SIGNUP,
+    TASK_LOGIN,
+    TASK_PROCESS,
+    TASK_CUST_SEARCH,
+    TASK_CUST_PRINT,
+    TASK_OP_SEARCH,
+    TASK_OP_PRINT
+} TaskKind;
+
+// One client connection. The event loop owns it, except while `busy`: a
+// worker then has the socket (switched to blocking mode) and the event loop
+// leaves the session alone until the worker hands it back.
+typedef struct Session {
+    int fd;
+    char ip[INET_ADDRSTRLEN];
+    MenuState state;
+    InputStep step;
+    char email[EMAIL_MAX];          // signup/login email awaiting its password
+    char logged_in_user[EMAIL_MAX];
+    char user_output_dir[256];
+    int cdr_processed;              // CDR data processed since login
+
+    LineReader in;                  // received bytes not yet consumed as lines
+    char *out;                      // output the socket has not taken yet
+    size_t out_len;
+    size_t out_cap;
+
+    int busy;                       // a worker runs `task`
+    TaskKind task;
+    char task_arg[BUFSIZE];
+    int task_result;                // outcome of a signup or login task
+    int closing;                    // close once the output is flushed
+    int dead;                       // peer gone or socket error
+    struct Session *next;           // worker pool queues
+} Session;
+
 /* ============================================================
    Function Declarations
    ============================================================ */
 
-// Socket communication helpers
+// Socket communication helper (blocking sockets)
 int sendall(int sock, const char *buf, size_t len);
-int send_line(int sock, const char *s);
-ssize_t recv_line(int sock, char *buf, size_t bufsize);
 
-// Client handling
-void* client_thread(void* arg);
-void handle_client(int client_fd);
+// Line reader primitives: take_line hands out the next buffered line
+// ('\r' dropped, at most bufsize - 1 bytes) and returns 0 if no complete
+// line is buffered; fill_line_reader does one recv() into the free space
+// and returns its result
+int take_line(LineReader *r, char *buf, size_t bufsize);
+ssize_t fill_line_reader(int sock, LineReader *r);
 
 #endif // SERVER_H
@@ -0,0 +1,144 @@
+// Arena.c - Per-job bump allocator for aggregation records and strings
+// Records are carved out of large blocks and released all at once, so a
+// processing run makes a handful of allocator calls instead of one per record.
+#include "../Header/Arena.h"
+
+_Static_assert(ARENA_ALIGN <= _Alignof(max_align_t), "malloc must align arena blocks");
+
+/* ============================================================
+   Block Allocation
+   ============================================================ */
+
+void* arenaAlloc(Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    ArenaBlock *block = arena->head;
+    if (!block || block->size - block->used < size) {
+        // Oversized requests get a block of their own
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + blockSize);
+        if (!block) return NULL;
+        block->used = 0;
+        block->size = blockSize;
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    void *p = block->data + block->used;
+    block->used += size;
+    memset(p, 0, size);
+    return p;
+}
+
+char* arenaStrndup(Arena *arena, const char *s, size_t len)
+{
+    char *copy = (char *)arenaAlloc(arena, len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+/* ============================================================
+   String Interning
+   ============================================================ */
+
+static unsigned long hashBytes(const char *s, size_t len)
+{
+    unsigned long hash = 5381;
+    for (size_t i = 0; i < len; i++)
+        hash = ((hash << 5) + hash) + (unsigned char)s[i]; /* hash * 33 + c */
+    return hash;
+}
+
+static int growStringIndex(Arena *arena)
+{
+    size_t newCap = arena->stringCap ? arena->stringCap * 2 : 64;
+    ArenaString *entries = (ArenaString *)calloc(newCap, sizeof(ArenaString));
+    if (!entries) return 0;
+
+    for (size_t i = 0; i < arena->stringCap; i++) {
+        ArenaString *e = &arena->strings[i];
+        if (!e->str) continue;
+        size_t j = e->hash & (newCap - 1);
+        while (entries[j].str)
+            j = (j + 1) & (newCap - 1);
+        entries[j] = *e;
+    }
+
+    free(arena->strings);
+    arena->strings = entries;
+    arena->stringCap = newCap;
+    return 1;
+}
+
+const char* arenaIntern(Arena *arena, const char *s, size_t len)
+{
+    // Keep the index at most half full
+    if ((arena->stringCount + 1) * 2 > arena->stringCap && !growStringIndex(arena))
+        return NULL;
+
+    unsigned long hash = hashBytes(s, len);
+    size_t mask = arena->stringCap - 1;
+    size_t i = hash & mask;
+    while (arena->strings[i].str) {
+        ArenaString *e = &arena->strings[i];
+        if (e->hash == hash && e->len == len && memcmp(e->str, s, len) == 0)
+            return e->str;
+        i = (i + 1) & mask;
+    }
+
+    char *copy = arenaStrndup(arena, s, len);
+    if (!copy) return NULL;
+    arena->strings[i].hash = hash;
+    arena->strings[i].str = copy;
+    arena->strings[i].len = len;
+    arena->stringCount++;
+    return copy;
+}
+
+/* ============================================================
+   Ownership Transfer and Release
+   ============================================================ */
+
+void arenaAdopt(Arena *dst, Arena *src)
+{
+    if (src->head) {
+        // Append src's chain behind dst's current block so dst keeps
+        // bump-allocating from its own head
+        ArenaBlock *tail = src->head;
+        while (tail->next)
+            tail = tail->next;
+        if (dst->head) {
+            tail->next = dst->head->next;
+            dst->head->next = src->head;
+        } else {
+            dst->head = src->head;
+        }
+    }
+
+    // src's strings remain valid but are no longer indexed for interning
+    free(src->strings);
+    memset(src, 0, sizeof(*src));
+}
+
+size_t arenaBytes(const Arena *arena)
+{
+    size_t bytes = arena->stringCap * sizeof(ArenaString);
+    for (const ArenaBlock *block = arena->head; block; block = block->next)
+        bytes += sizeof(ArenaBlock) + block->size;
+    return bytes;
+}
+
+void arenaRelease(Arena *arena)
+{
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena->strings);
+    memset(arena, 0, sizeof(*arena));
+}
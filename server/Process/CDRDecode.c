@@ -0,0 +1,299 @@
+// CDRDecode.c - Pipelined decompression of compressed CDR inputs
+// Archived CDR files are read compressed and decoded on a background thread
+// into a small ring of buffers that the parser consumes directly, so the
+// decoded text never touches the disk.
+#define _GNU_SOURCE // posix_spawn_file_actions_addclosefrom_np
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <zlib.h>
+#include "../Header/CDRDecode.h"
+
+extern char **environ;
+
+/* ============================================================
+   Codec Detection
+   ============================================================ */
+
+CDRCodec cdrDetectCodec(int fd)
+{
+    unsigned char magic[4];
+    ssize_t n = pread(fd, magic, sizeof(magic), 0);
+    if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+        return CDR_CODEC_GZIP;
+    if (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+        return CDR_CODEC_ZSTD;
+    return CDR_CODEC_NONE;
+}
+
+const char* cdrCodecName(CDRCodec codec)
+{
+    switch (codec) {
+    case CDR_CODEC_GZIP: return "gzip";
+    case CDR_CODEC_ZSTD: return "zstd";
+    default:             return "none";
+    }
+}
+
+/* ============================================================
+   Ring Buffer (Decoder Side)
+   ============================================================ */
+
+// Slot to fill next; waits while the parser still holds every slot.
+// NULL if the parser closed the decoder.
+static char* acquireSlot(CDRDecoder *d)
+{
+    pthread_mutex_lock(&d->lock);
+    while (d->filled == CDR_DECODE_SLOTS && !d->stop)
+        pthread_cond_wait(&d->notFull, &d->lock);
+    char *slot = d->stop ? NULL : d->slots[d->head];
+    pthread_mutex_unlock(&d->lock);
+    return slot;
+}
+
+static void publishSlot(CDRDecoder *d, size_t len)
+{
+    pthread_mutex_lock(&d->lock);
+    d->lens[d->head] = len;
+    d->head = (d->head + 1) % CDR_DECODE_SLOTS;
+    d->filled++;
+    pthread_cond_signal(&d->notEmpty);
+    pthread_mutex_unlock(&d->lock);
+}
+
+static void finishDecoding(CDRDecoder *d, int failed)
+{
+    pthread_mutex_lock(&d->lock);
+    d->done = 1;
+    d->failed = failed;
+    pthread_cond_broadcast(&d->notEmpty);
+    pthread_mutex_unlock(&d->lock);
+}
+
+/* ============================================================
+   Codecs (Decoder Thread)
+   ============================================================ */
+
+// gzip with zlib; concatenated members (e.g. appended archives) are decoded
+// one after the other
+static int inflateGzip(CDRDecoder *d)
+{
+    unsigned char *in = (unsigned char *)malloc(CDR_DECODE_INPUT);
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (!in || inflateInit2(&z, 15 + 16) != Z_OK) {
+        free(in);
+        return -1;
+    }
+
+    char *out = acquireSlot(d);
+    size_t outLen = 0;
+    int eof = 0, ended = 0, failed = 0;
+    while (out) {
+        if (z.avail_in == 0 && !eof) {
+            ssize_t n = read(d->fd, in, CDR_DECODE_INPUT);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                failed = 1;
+                break;
+            }
+            if (n == 0) {
+                eof = 1;
+            } else {
+                z.next_in = in;
+                z.avail_in = (uInt)n;
+            }
+        }
+        if (z.avail_in == 0 && eof) {
+            failed = !ended; // the last member must be complete
+            break;
+        }
+        if (ended) {
+            // Another member follows the one that ended
+            inflateReset(&z);
+            ended = 0;
+        }
+
+        z.next_out = (Bytef *)out + outLen;
+        z.avail_out = (uInt)(CDR_DECODE_CHUNK - outLen);
+        int rc = inflate(&z, Z_NO_FLUSH);
+        outLen = CDR_DECODE_CHUNK - z.avail_out;
+        if (rc == Z_STREAM_END) {
+            ended = 1;
+        } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+            failed = 1;
+            break;
+        }
+
+        if (outLen == CDR_DECODE_CHUNK) {
+            publishSlot(d, outLen);
+            out = acquireSlot(d);
+            outLen = 0;
+        }
+    }
+    if (out && outLen > 0)
+        publishSlot(d, outLen);
+
+    inflateEnd(&z);
+    free(in);
+    return failed ? -1 : 0;
+}
+
+// zstd: the zstd tool decodes the file (its stdin) into a pipe, which this
+// thread drains into the ring
+static int readChildOutput(CDRDecoder *d)
+{
+    char *out = acquireSlot(d);
+    size_t outLen = 0;
+    int failed = 0;
+    while (out) {
+        ssize_t n = read(d->childOut, out + outLen, CDR_DECODE_CHUNK - outLen);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) failed = 1;
+        if (n <= 0) break;
+
+        outLen += (size_t)n;
+        if (outLen == CDR_DECODE_CHUNK) {
+            publishSlot(d, outLen);
+            out = acquireSlot(d);
+            outLen = 0;
+        }
+    }
+    if (out && outLen > 0)
+        publishSlot(d, outLen);
+
+    // Closing the pipe ends the child early if the parser stopped
+    close(d->childOut);
+    d->childOut = -1;
+    int status = 0;
+    while (waitpid(d->child, &status, 0) < 0 && errno == EINTR)
+        ;
+    d->child = 0;
+    if (!out) return 0;
+    return failed || !WIFEXITED(status) || WEXITSTATUS(status) != 0 ? -1 : 0;
+}
+
+static int spawnDecompressor(CDRDecoder *d, const char *tool)
+{
+    int pipefd[2];
+    if (pipe(pipefd) != 0) return -1;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, d->fd, STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, pipefd[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, pipefd[0]);
+    posix_spawn_file_actions_addclose(&actions, pipefd[1]);
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+    // The tool needs nothing else: descriptors other threads opened without
+    // O_CLOEXEC (report files, client sockets) must not stay open in it
+    posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+#endif
+
+    char *argv[] = { (char *)tool, "-dc", NULL };
+    pid_t pid;
+    int rc = posix_spawnp(&pid, tool, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pipefd[1]);
+    if (rc != 0) {
+        close(pipefd[0]);
+        return -1;
+    }
+    d->child = pid;
+    d->childOut = pipefd[0];
+    return 0;
+}
+
+static void* decoderThread(void *arg)
+{
+    CDRDecoder *d = (CDRDecoder *)arg;
+    int rc = d->codec == CDR_CODEC_GZIP ? inflateGzip(d) : readChildOutput(d);
+    finishDecoding(d, rc != 0);
+    return NULL;
+}
+
+/* ============================================================
+   Decoder Lifecycle (Parser Side)
+   ============================================================ */
+
+static void freeDecoder(CDRDecoder *d)
+{
+    for (int i = 0; i < CDR_DECODE_SLOTS; i++)
+        free(d->slots[i]);
+    pthread_mutex_destroy(&d->lock);
+    pthread_cond_destroy(&d->notEmpty);
+    pthread_cond_destroy(&d->notFull);
+    free(d);
+}
+
+CDRDecoder* cdrDecoderOpen(int fd, CDRCodec codec)
+{
+    if (codec != CDR_CODEC_GZIP && codec != CDR_CODEC_ZSTD) return NULL;
+
+    CDRDecoder *d = (CDRDecoder *)calloc(1, sizeof(CDRDecoder));
+    if (!d) return NULL;
+    d->fd = fd;
+    d->codec = codec;
+    d->childOut = -1;
+    pthread_mutex_init(&d->lock, NULL);
+    pthread_cond_init(&d->notEmpty, NULL);
+    pthread_cond_init(&d->notFull, NULL);
+
+    int ok = 1;
+    for (int i = 0; i < CDR_DECODE_SLOTS && ok; i++)
+        ok = (d->slots[i] = (char *)malloc(CDR_DECODE_CHUNK)) != NULL;
+    if (ok && codec == CDR_CODEC_ZSTD)
+        ok = spawnDecompressor(d, "zstd") == 0;
+    if (ok && pthread_create(&d->thread, NULL, decoderThread, d) != 0) {
+        if (d->child) {
+            close(d->childOut);
+            kill(d->child, SIGTERM);
+            waitpid(d->child, NULL, 0);
+        }
+        ok = 0;
+    }
+    if (!ok) {
+        freeDecoder(d);
+        return NULL;
+    }
+    return d;
+}
+
+const char* cdrDecoderNext(CDRDecoder *d, size_t *len)
+{
+    pthread_mutex_lock(&d->lock);
+    while (d->filled == 0 && !d->done)
+        pthread_cond_wait(&d->notEmpty, &d->lock);
+    const char *buf = NULL;
+    if (d->filled > 0) {
+        buf = d->slots[d->tail];
+        *len = d->lens[d->tail];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return buf;
+}
+
+void cdrDecoderRelease(CDRDecoder *d)
+{
+    pthread_mutex_lock(&d->lock);
+    d->tail = (d->tail + 1) % CDR_DECODE_SLOTS;
+    d->filled--;
+    pthread_cond_signal(&d->notFull);
+    pthread_mutex_unlock(&d->lock);
+}
+
+int cdrDecoderClose(CDRDecoder *d)
+{
+    pthread_mutex_lock(&d->lock);
+    d->stop = 1;
+    pthread_cond_broadcast(&d->notFull);
+    pthread_mutex_unlock(&d->lock);
+
+    pthread_join(d->thread, NULL);
+    int rc = d->failed ? -1 : 0;
+    freeDecoder(d);
+    return rc;
+}
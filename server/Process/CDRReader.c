@@ -0,0 +1,710 @@
+// CDRReader.c - Shared single-pass CDR reader
+// Reads and tokenizes each CDR line once, then dispatches the parsed record
+// to every registered aggregator (customer, interoperator, ...).
+// Regular files are parsed straight out of an mmap'd view; fields are
+// pointer+length views so no per-line or per-field copies are made.
+// Compressed (gzip, zstd) files are decoded on a background thread and
+// parsed from its buffers as they fill.
+#include <dirent.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../Header/CDRDecode.h"
+#include "../Header/CDRReader.h"
+#include "../Header/CDRSplit.h"
+
+/* ============================================================
+   Number Parsers (Internal)
+   ============================================================ */
+
+// Integer from [p, end): optional sign then decimal digits. Returns the first
+// unconsumed byte; *ok is cleared when there are no digits or too many.
+static const char *parseInt(const char *p, const char *end, long *out, int *ok)
+{
+    int neg = (p < end && *p == '-');
+    p += (p < end && (*p == '-' || *p == '+'));
+
+    const char *digits = p;
+    unsigned long v = 0;
+    while (p < end && (unsigned)(*p - '0') < 10)
+        v = v * 10 + (unsigned)(*p++ - '0');
+
+    *ok = (p != digits) && (p - digits) <= 18;
+    *out = (long)(neg ? 0 - v : v);
+    return p;
+}
+
+// Decimal from [p, end) as a fixed-point integer scaled by CDR_FIXED_SCALE
+// (3 decimals). Extra fraction digits are dropped, not rounded.
+static const char *parseFixed(const char *p, const char *end, long long *out, int *ok)
+{
+    int neg = (p < end && *p == '-');
+    p += (p < end && (*p == '-' || *p == '+'));
+
+    const char *digits = p;
+    unsigned long long whole = 0; // unsigned: over-long input wraps, then is rejected
+    while (p < end && (unsigned)(*p - '0') < 10)
+        whole = whole * 10 + (unsigned)(*p++ - '0');
+    int intDigits = (int)(p - digits);
+
+    unsigned long long frac = 0;
+    int fracDigits = 0;
+    if (p < end && *p == '.') {
+        p++;
+        const char *f = p;
+        while (p < end && (unsigned)(*p - '0') < 10) {
+            if (p - f < 3)
+                frac = frac * 10 + (unsigned)(*p - '0');
+            p++;
+        }
+        fracDigits = (int)(p - f);
+        for (int i = fracDigits; i < 3; i++)
+            frac *= 10;
+    }
+
+    *ok = (intDigits + fracDigits > 0) && intDigits <= 15;
+    unsigned long long v = whole * CDR_FIXED_SCALE + frac;
+    *out = (long long)(neg ? 0 - v : v);
+    return p;
+}
+
+/* ============================================================
+   Field View Helpers
+   ============================================================ */
+
+// Whole-field integer; whole = 0 accepts trailing text after the number
+static int parseLongField(CDRField f, long *out, int whole)
+{
+    int ok;
+    const char *end = f.ptr + f.len;
+    const char *p = parseInt(f.ptr, end, out, &ok);
+    return ok && (!whole || p == end);
+}
+
+// Fixed-point value of the field's numeric prefix (0 when there is none);
+// *whole reports whether the entire field was a valid number
+static long long fixedField(CDRField f, int *whole)
+{
+    int ok;
+    long long v;
+    const char *end = f.ptr + f.len;
+    const char *p = parseFixed(f.ptr, end, &v, &ok);
+    *whole = ok && p == end;
+    return ok ? v : 0;
+}
+
+/* ============================================================
+   Call Types
+   ============================================================ */
+
+// Case-insensitive compare against a lower-case pattern. OR-ing 0x20 folds
+// letters; '-' only collides with '\r', which never occurs inside a field.
+static int foldEquals(const char *p, const char *lower, size_t n)
+{
+    unsigned diff = 0;
+    for (size_t i = 0; i < n; i++)
+        diff |= (unsigned)((p[i] | 0x20) ^ lower[i]);
+    return diff == 0;
+}
+
+CDRCallType cdrCallType(CDRField f, int *exact)
+{
+    const char *p = f.ptr;
+    CDRCallType type = CDR_CALL_UNKNOWN;
+    const char *canonical = NULL; // upper-case spelling of the match
+
+    // The length picks the candidates; one folded compare settles each
+    switch (f.len) {
+    case 3:
+        if (foldEquals(p, "moc", 3)) {
+            type = CDR_CALL_MOC;
+            canonical = "MOC";
+        } else if (foldEquals(p, "mtc", 3)) {
+            type = CDR_CALL_MTC;
+            canonical = "MTC";
+        }
+        break;
+    case 4:
+        if (foldEquals(p, "gprs", 4)) {
+            type = CDR_CALL_GPRS;
+            canonical = "GPRS";
+        }
+        break;
+    case 6:
+        if (foldEquals(p, "sms-mo", 6)) {
+            type = CDR_CALL_SMS_MO;
+            canonical = "SMS-MO";
+        } else if (foldEquals(p, "sms-mt", 6)) {
+            type = CDR_CALL_SMS_MT;
+            canonical = "SMS-MT";
+        }
+        break;
+    }
+
+    *exact = canonical && memcmp(p, canonical, f.len) == 0;
+    return type;
+}
+
+/* ============================================================
+   Line Parser
+   ============================================================ */
+
+// Decode the typed fields of an already split record.
+// Volumes are always decoded (numeric prefix, 0 if none) for lenient
+// consumers; typedValid additionally requires every typed field to be
+// a complete number. The third party MSISDN may be empty (GPRS records).
+static void decodeRecord(CDRRecord *rec)
+{
+    rec->callType = cdrCallType(rec->fields[3], &rec->callTypeExact);
+
+    int durOk, dlOk, ulOk;
+    rec->duration = fixedField(rec->fields[4], &durOk);
+    rec->download = fixedField(rec->fields[5], &dlOk);
+    rec->upload = fixedField(rec->fields[6], &ulOk);
+
+    long opCode = 0, thirdOpCode = 0;
+    rec->thirdPartyMsisdn = 0;
+    rec->typedValid =
+        parseLongField(rec->fields[0], &rec->msisdn, 1) &&
+        rec->fields[1].len > 0 &&
+        parseLongField(rec->fields[2], &opCode, 1) &&
+        rec->fields[3].len > 0 && rec->fields[3].len < 16 &&
+        durOk && dlOk && ulOk &&
+        (rec->fields[7].len == 0 ||
+         parseLongField(rec->fields[7], &rec->thirdPartyMsisdn, 1)) &&
+        parseLongField(rec->fields[8], &thirdOpCode, 0);
+
+    rec->operatorCode = (int)opCode;
+    rec->thirdPartyOpCode = (int)thirdOpCode;
+}
+
+// Fill the field views of [line, end) from the positions of its first
+// nbars '|' separators; the last field keeps any remaining text and
+// missing fields become empty views
+static void setFields(CDRRecord *rec, const char *line, const char *end,
+                      const char *const *bars, int nbars)
+{
+    const char *p = line;
+    for (int i = 0; i < nbars; i++) {
+        rec->fields[i].ptr = p;
+        rec->fields[i].len = (size_t)(bars[i] - p);
+        p = bars[i] + 1;
+    }
+    rec->fields[nbars].ptr = p;
+    rec->fields[nbars].len = (size_t)(end - p);
+    for (int i = nbars + 1; i < CDR_FIELD_COUNT; i++) {
+        rec->fields[i].ptr = end;
+        rec->fields[i].len = 0;
+    }
+    rec->fieldCount = nbars + 1;
+}
+
+int parseCDRLine(const char *line, size_t len, CDRRecord *rec)
+{
+    // Ignore carriage returns left by CRLF files
+    const char *cr = memchr(line, '\r', len);
+    if (cr) len = (size_t)(cr - line);
+    if (len == 0) return 0;
+
+    const char *end = line + len;
+    const char *bars[CDR_FIELD_COUNT - 1];
+    int nbars = 0;
+    for (const char *p = line; nbars < CDR_FIELD_COUNT - 1; nbars++) {
+        const char *bar = memchr(p, '|', (size_t)(end - p));
+        if (!bar) break;
+        bars[nbars] = bar;
+        p = bar + 1;
+    }
+
+    setFields(rec, line, end, bars, nbars);
+    decodeRecord(rec);
+    return 1;
+}
+
+/* ============================================================
+   Buffer Dispatch (Internal)
+   ============================================================ */
+
+static void consumeRecord(const CDRRecord *rec, const CDRAggregator *aggs,
+                          int aggCount, CDRScanStats *stats)
+{
+    for (int i = 0; i < aggCount; i++)
+        aggs[i].consume(rec, aggs[i].ctx);
+    stats->records++;
+    stats->malformed += !rec->typedValid;
+}
+
+// Hand one split line to every aggregator (blank lines are skipped)
+static void dispatchRecord(const char *line, const char *end,
+                           const char *const *bars, int nbars,
+                           const CDRAggregator *aggs, int aggCount,
+                           CDRScanStats *stats)
+{
+    if (line == end) return;
+
+    CDRRecord rec;
+    setFields(&rec, line, end, bars, nbars);
+    decodeRecord(&rec);
+    consumeRecord(&rec, aggs, aggCount, stats);
+}
+
+// Parse every complete ('\n'-terminated) line in the buffer and hand it to
+// all aggregators; with final = 1 a trailing line without '\n' is included.
+// Returns the number of bytes consumed.
+//
+// The buffer is indexed CDR_SPLIT_BLOCK bytes at a time: cdrFindDelims
+// locates every '|', '\r' and '\n' in the block with vector compares, and the
+// lines are then split by walking that offset list. A line cut by the end of
+// a block is rescanned as the start of the next one.
+static size_t dispatchLines(const char *data, size_t len, int final,
+                            const CDRAggregator *aggs, int aggCount,
+                            CDRScanStats *stats)
+{
+    uint16_t pos[CDR_SPLIT_BLOCK];
+    const char *p = data;
+    const char *end = data + len;
+
+    while (p < end) {
+        size_t blockLen = (size_t)(end - p);
+        if (blockLen > CDR_SPLIT_BLOCK) blockLen = CDR_SPLIT_BLOCK;
+        size_t n = cdrFindDelims(p, blockLen, pos);
+
+        // Split state of the line being walked
+        const char *line = p;
+        const char *cr = NULL;
+        const char *bars[CDR_FIELD_COUNT - 1];
+        int nbars = 0;
+
+        for (size_t k = 0; k < n; k++) {
+            const char *d = p + pos[k];
+            if (*d == '|') {
+                if (!cr && nbars < CDR_FIELD_COUNT - 1)
+                    bars[nbars++] = d;
+            } else if (*d == '\r') {
+                if (!cr) cr = d; // text after a carriage return is ignored
+            } else {
+                dispatchRecord(line, cr ? cr : d, bars, nbars, aggs, aggCount, stats);
+                line = d + 1;
+                cr = NULL;
+                nbars = 0;
+            }
+        }
+
+        int lastBlock = (p + blockLen == end);
+        if (lastBlock) {
+            // Unterminated trailing line
+            if (!final) return (size_t)(line - data);
+            if (line < end)
+                dispatchRecord(line, cr ? cr : end, bars, nbars, aggs, aggCount, stats);
+            return len;
+        }
+
+        if (line == p) {
+            // A single line longer than a block: find its end directly
+            const char *nl = memchr(p, '\n', (size_t)(end - p));
+            if (!nl && !final) return (size_t)(p - data);
+            const char *stop = nl ? nl : end;
+            CDRRecord rec;
+            if (parseCDRLine(p, (size_t)(stop - p), &rec))
+                consumeRecord(&rec, aggs, aggCount, stats);
+            line = nl ? nl + 1 : end;
+        }
+        p = line;
+    }
+    return (size_t)(p - data);
+}
+
+/* ============================================================
+   Ingestion Paths (Internal)
+   ============================================================ */
+
+// Zero-copy path for regular files: parse directly from the mapped pages
+static int scanMapped(int fd, size_t size, const CDRAggregator *aggs, int aggCount,
+                      CDRScanStats *stats)
+{
+    if (size == 0) return 0;
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) return -1;
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    dispatchLines((const char *)map, size, 1, aggs, aggCount, stats);
+
+    munmap(map, size);
+    return 0;
+}
+
+// Fallback for pipes and other non-seekable inputs: large read() chunks,
+// carrying any partial line over to the next chunk
+static int scanBuffered(int fd, const CDRAggregator *aggs, int aggCount,
+                        CDRScanStats *stats)
+{
+    size_t cap = CDR_READ_CHUNK;
+    size_t have = 0;
+    char *buf = (char *)malloc(cap);
+    if (!buf) return -1;
+
+    for (;;) {
+        // Grow when a single line does not fit in the buffer
+        if (have == cap) {
+            char *bigger = (char *)realloc(buf, cap * 2);
+            if (!bigger) break;
+            buf = bigger;
+            cap *= 2;
+        }
+
+        ssize_t n = read(fd, buf + have, cap - have);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        have += (size_t)n;
+
+        size_t used = dispatchLines(buf, have, 0, aggs, aggCount, stats);
+        memmove(buf, buf + used, have - used);
+        have -= used;
+    }
+
+    dispatchLines(buf, have, 1, aggs, aggCount, stats);
+    free(buf);
+    return 0;
+}
+
+// Append n bytes to the carried partial line
+static int carryAppend(char **carry, size_t *len, size_t *cap, const char *p, size_t n)
+{
+    if (n == 0) return 0;
+    if (*len + n > *cap) {
+        size_t want = *cap ? *cap : CDR_READ_CHUNK;
+        while (want < *len + n) want *= 2;
+        char *bigger = (char *)realloc(*carry, want);
+        if (!bigger) return -1;
+        *carry = bigger;
+        *cap = want;
+    }
+    memcpy(*carry + *len, p, n);
+    *len += n;
+    return 0;
+}
+
+// Compressed input: a decoder thread fills a ring of buffers while this
+// thread parses them in place. Only a line cut by the end of a buffer is
+// copied, into a small carry buffer completed from the next one.
+static int scanDecoded(int fd, CDRCodec codec, const CDRAggregator *aggs, int aggCount,
+                       CDRScanStats *stats)
+{
+    CDRDecoder *dec = cdrDecoderOpen(fd, codec);
+    if (!dec) return -1;
+
+    char *carry = NULL;
+    size_t carryLen = 0, carryCap = 0;
+    int rc = 0;
+    const char *buf;
+    size_t len;
+    while (rc == 0 && (buf = cdrDecoderNext(dec, &len)) != NULL) {
+        const char *p = buf;
+        const char *end = buf + len;
+        if (carryLen > 0) {
+            const char *nl = memchr(p, '\n', len);
+            const char *stop = nl ? nl + 1 : end;
+            rc = carryAppend(&carry, &carryLen, &carryCap, p, (size_t)(stop - p));
+            if (rc == 0 && nl) {
+                dispatchLines(carry, carryLen, 1, aggs, aggCount, stats);
+                carryLen = 0;
+            }
+            p = stop;
+        }
+        if (rc == 0 && p < end) {
+            size_t used = dispatchLines(p, (size_t)(end - p), 0, aggs, aggCount, stats);
+            rc = carryAppend(&carry, &carryLen, &carryCap, p + used, (size_t)(end - p) - used);
+        }
+        cdrDecoderRelease(dec);
+    }
+
+    if (rc == 0 && carryLen > 0)
+        dispatchLines(carry, carryLen, 1, aggs, aggCount, stats);
+    free(carry);
+
+    // A truncated or corrupt archive fails the decoder
+    if (cdrDecoderClose(dec) != 0) rc = -1;
+    return rc;
+}
+
+/* ============================================================
+   Parallel Range Scan (Internal)
+   ============================================================ */
+
+typedef struct {
+    const char *begin;
+    const char *end;
+    const CDRAggregator *aggs; // this worker's private aggregator set
+    int aggCount;
+    CDRScanStats stats;
+} ScanRange;
+
+static void *scanRangeThread(void *arg)
+{
+    ScanRange *r = (ScanRange *)arg;
+
+    // Only the last range can end without a newline
+    dispatchLines(r->begin, (size_t)(r->end - r->begin), 1,
+                  r->aggs, r->aggCount, &r->stats);
+    return NULL;
+}
+
+int cdrWorkerCount(void)
+{
+    long n = 0;
+    const char *env = getenv(CDR_WORKERS_ENV);
+    if (env && *env)
+        n = strtol(env, NULL, 10);
+    if (n <= 0)
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > CDR_MAX_WORKERS) n = CDR_MAX_WORKERS;
+    return (int)n;
+}
+
+/* ============================================================
+   Single-Pass File Scan
+   ============================================================ */
+
+long scanCDRFile(const char *filename, const CDRAggregator *aggs, int aggCount,
+                 CDRScanStats *stats)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening CDR file '%s': %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    CDRScanStats local = {0, 0};
+    struct stat st;
+    int rc = -1;
+    CDRCodec codec = cdrDetectCodec(fd);
+    if (codec != CDR_CODEC_NONE) {
+        rc = scanDecoded(fd, codec, aggs, aggCount, &local);
+        close(fd);
+        if (rc < 0) {
+            fprintf(stderr, "Error decompressing CDR file '%s' (%s)\n", filename,
+                    cdrCodecName(codec));
+            return -1;
+        }
+        if (stats) *stats = local;
+        return local.records;
+    }
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+        rc = scanMapped(fd, (size_t)st.st_size, aggs, aggCount, &local);
+
+    // Non-regular input, or the mapping failed
+    if (rc < 0)
+        rc = scanBuffered(fd, aggs, aggCount, &local);
+
+    close(fd);
+    if (rc < 0) return -1;
+    if (stats) *stats = local;
+    return local.records;
+}
+
+long scanCDRFileFrom(const char *filename, uint64_t start, int flags,
+                     const CDRAggregator *aggs, int aggCount, int workers,
+                     CDRScanStats *stats, CDRInputInfo *info)
+{
+    if (cdrInputCompressed(filename)) return -1;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (uint64_t)st.st_size < start) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    if (info) {
+        info->dev = (uint64_t)st.st_dev;
+        info->ino = (uint64_t)st.st_ino;
+        info->start = start;
+        info->end = size;
+        info->complete = 1;
+    }
+    if (size == start) {
+        // Nothing (new) to scan
+        close(fd);
+        if (stats) stats->records = stats->malformed = 0;
+        return 0;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    // Bytes to scan: all of them, or up to the last complete line
+    size_t scanEnd = size;
+    if (flags & CDR_SCAN_WHOLE_LINES) {
+        while (scanEnd > (size_t)start && ((const char *)map)[scanEnd - 1] != '\n')
+            scanEnd--;
+    }
+    if (info) {
+        info->end = scanEnd;
+        info->complete = scanEnd == (size_t)start || ((const char *)map)[scanEnd - 1] == '\n';
+    }
+    if (scanEnd == (size_t)start) {
+        munmap(map, size);
+        if (stats) stats->records = stats->malformed = 0;
+        return 0;
+    }
+
+    // Small files are not worth splitting
+    size_t span = scanEnd - (size_t)start;
+    if (workers > CDR_MAX_WORKERS) workers = CDR_MAX_WORKERS;
+    if ((size_t)workers > span / CDR_MIN_SPLIT + 1)
+        workers = (int)(span / CDR_MIN_SPLIT + 1);
+    if (workers < 1) workers = 1;
+
+    // Cut the mapping into ranges that start right after a newline
+    const char *data = (const char *)map + start;
+    const char *end = data + span;
+    ScanRange ranges[CDR_MAX_WORKERS];
+    const char *begin = data;
+    int count = 0;
+    for (int w = 0; w < workers && begin < end; w++) {
+        const char *stop = end;
+        if (w < workers - 1) {
+            stop = data + span / workers * (w + 1);
+            if (stop < begin) stop = begin;
+            const char *nl = memchr(stop, '\n', (size_t)(end - stop));
+            stop = nl ? nl + 1 : end;
+        }
+        ranges[count].begin = begin;
+        ranges[count].end = stop;
+        ranges[count].aggs = aggs + (size_t)w * aggCount;
+        ranges[count].aggCount = aggCount;
+        ranges[count].stats.records = 0;
+        ranges[count].stats.malformed = 0;
+        count++;
+        begin = stop;
+    }
+
+    // Range 0 runs on the calling thread
+    pthread_t tids[CDR_MAX_WORKERS];
+    int started[CDR_MAX_WORKERS] = {0};
+    for (int i = 1; i < count; i++)
+        started[i] = (pthread_create(&tids[i], NULL, scanRangeThread, &ranges[i]) == 0);
+    scanRangeThread(&ranges[0]);
+
+    CDRScanStats total = ranges[0].stats;
+    for (int i = 1; i < count; i++) {
+        if (started[i])
+            pthread_join(tids[i], NULL);
+        else
+            scanRangeThread(&ranges[i]); // could not spawn: scan it here
+        total.records += ranges[i].stats.records;
+        total.malformed += ranges[i].stats.malformed;
+    }
+
+    munmap(map, size);
+    if (stats) *stats = total;
+    return total.records;
+}
+
+/* ============================================================
+   Input Selection
+   ============================================================ */
+
+const char* cdrInputSpec(void)
+{
+    const char *env = getenv(CDR_INPUT_ENV);
+    return env && *env ? env : CDR_INPUT_FILE;
+}
+
+int cdrInputCompressed(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return 0;
+    CDRCodec codec = cdrDetectCodec(fd);
+    close(fd);
+    return codec != CDR_CODEC_NONE;
+}
+
+static int addInputPath(CDRInputSet *set, const char *path)
+{
+    if (set->count >= CDR_MAX_INPUT_FILES) return -1;
+    if (set->count % 64 == 0) {
+        char **grown = (char **)realloc(set->paths, (set->count + 64) * sizeof(char *));
+        if (!grown) return -1;
+        set->paths = grown;
+    }
+    set->paths[set->count] = strdup(path);
+    if (!set->paths[set->count]) return -1;
+    set->count++;
+    return 0;
+}
+
+static int isRegularFile(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static int comparePaths(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+int cdrInputSetOpen(const char *spec, CDRInputSet *set)
+{
+    set->paths = NULL;
+    set->count = 0;
+    int rc = 0;
+
+    struct stat st;
+    if (stat(spec, &st) == 0 && S_ISDIR(st.st_mode)) {
+        // Every regular, non-hidden file of the directory
+        DIR *dir = opendir(spec);
+        if (!dir) return -1;
+        struct dirent *ent;
+        char path[4096];
+        while (rc == 0 && (ent = readdir(dir)) != NULL) {
+            if (ent->d_name[0] == '.') continue;
+            snprintf(path, sizeof(path), "%s/%s", spec, ent->d_name);
+            if (isRegularFile(path))
+                rc = addInputPath(set, path);
+        }
+        closedir(dir);
+    } else if (strpbrk(spec, "*?[")) {
+        glob_t g;
+        int grc = glob(spec, 0, NULL, &g);
+        if (grc == 0) {
+            for (size_t i = 0; i < g.gl_pathc && rc == 0; i++)
+                if (isRegularFile(g.gl_pathv[i]))
+                    rc = addInputPath(set, g.gl_pathv[i]);
+        } else if (grc != GLOB_NOMATCH) {
+            rc = -1;
+        }
+        globfree(&g);
+    } else {
+        rc = addInputPath(set, spec);
+    }
+
+    if (rc != 0) {
+        cdrInputSetFree(set);
+        return -1;
+    }
+    qsort(set->paths, (size_t)set->count, sizeof(char *), comparePaths);
+    return 0;
+}
+
+void cdrInputSetFree(CDRInputSet *set)
+{
+    for (int i = 0; i < set->count; i++)
+        free(set->paths[i]);
+    free(set->paths);
+    set->paths = NULL;
+    set->count = 0;
+}
@@ -0,0 +1,165 @@
+// Checkpoint.c - Resume point for incremental CDR processing
+// A run that finishes on a record boundary leaves CDR.ckpt next to its
+// results. The next run of the same directory reloads CB.col / IOSB.col as
+// its starting state and scans only the bytes appended to the input since.
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../Header/Checkpoint.h"
+#include "../Header/CustBillProcess.h"
+#include "../Header/IntopBillProcess.h"
+
+/* ============================================================
+   Helpers (Internal)
+   ============================================================ */
+
+int checkpointEnabled(void)
+{
+    const char *env = getenv(CKPT_ENV);
+    return !(env && strcmp(env, "0") == 0);
+}
+
+static void checkpointPath(const char *output_dir, const char *name, char *out, size_t size)
+{
+    snprintf(out, size, "%s/%s", output_dir, name);
+}
+
+// FNV-1a of input bytes [from, to); 0 if they cannot all be read
+static uint64_t hashRange(int fd, uint64_t from, uint64_t to)
+{
+    char buf[CKPT_SAMPLE];
+    uint64_t hash = 1469598103934665603ULL;
+    while (from < to) {
+        size_t want = (size_t)(to - from) < sizeof(buf) ? (size_t)(to - from) : sizeof(buf);
+        ssize_t n = pread(fd, buf, want, (off_t)from);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        for (ssize_t i = 0; i < n; i++) {
+            hash ^= (unsigned char)buf[i];
+            hash *= 1099511628211ULL;
+        }
+        from += (uint64_t)n;
+    }
+    return hash;
+}
+
+// Hashes of the samples that pin down the first `offset` bytes of the input
+static void sampleInput(int fd, uint64_t offset, uint64_t *headHash, uint64_t *tailHash)
+{
+    uint64_t head = offset < CKPT_SAMPLE ? offset : CKPT_SAMPLE;
+    *headHash = hashRange(fd, 0, head);
+    *tailHash = hashRange(fd, offset - head, offset);
+}
+
+static int fileIdentity(const char *path, uint64_t *ino, uint64_t *size)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+    *ino = (uint64_t)st.st_ino;
+    *size = (uint64_t)st.st_size;
+    return 0;
+}
+
+/* ============================================================
+   Load / Save
+   ============================================================ */
+
+int loadCheckpoint(const char *output_dir, const char *input_path, CDRCheckpoint *ckpt)
+{
+    char path[512];
+    checkpointPath(output_dir, CKPT_FILE, path, sizeof(path));
+    memset(ckpt, 0, sizeof(*ckpt));
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return -1;
+    size_t got = fread(ckpt, sizeof(*ckpt), 1, fp);
+    fclose(fp);
+    if (got != 1 || memcmp(ckpt->magic, CKPT_MAGIC, sizeof(ckpt->magic)) != 0 ||
+        ckpt->version != CKPT_VERSION)
+        return -1;
+
+    // The result files must still be the ones written from this state
+    uint64_t ino, size;
+    checkpointPath(output_dir, CB_COLUMN_FILE, path, sizeof(path));
+    if (fileIdentity(path, &ino, &size) != 0 || ino != ckpt->cbIno || size != ckpt->cbSize)
+        return -1;
+    checkpointPath(output_dir, IOSB_COLUMN_FILE, path, sizeof(path));
+    if (fileIdentity(path, &ino, &size) != 0 || ino != ckpt->iosbIno || size != ckpt->iosbSize)
+        return -1;
+
+    // Same input file, only appended to: it still holds the checkpointed
+    // bytes and their samples hash the same
+    int fd = open(input_path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    int ok = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+             (uint64_t)st.st_dev == ckpt->inputDev && (uint64_t)st.st_ino == ckpt->inputIno &&
+             (uint64_t)st.st_size >= ckpt->offset;
+    if (ok) {
+        uint64_t headHash, tailHash;
+        sampleInput(fd, ckpt->offset, &headHash, &tailHash);
+        ok = headHash == ckpt->headHash && tailHash == ckpt->tailHash;
+    }
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+int saveCheckpoint(const char *output_dir, const char *input_path,
+                   const CDRInputInfo *info, long records, long malformed)
+{
+    static unsigned long tmpCounter = 0;
+
+    // A scan that stopped inside a record cannot be resumed
+    if (!info->complete) return -1;
+
+    CDRCheckpoint ckpt;
+    memset(&ckpt, 0, sizeof(ckpt));
+    memcpy(ckpt.magic, CKPT_MAGIC, sizeof(ckpt.magic));
+    ckpt.version = CKPT_VERSION;
+    ckpt.inputDev = info->dev;
+    ckpt.inputIno = info->ino;
+    ckpt.offset = info->end;
+    ckpt.records = records;
+    ckpt.malformed = malformed;
+
+    // Sample the bytes the scan saw (the file may have grown since)
+    int fd = open(input_path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    int ok = fstat(fd, &st) == 0 &&
+             (uint64_t)st.st_dev == info->dev && (uint64_t)st.st_ino == info->ino &&
+             (uint64_t)st.st_size >= info->end;
+    if (ok)
+        sampleInput(fd, info->end, &ckpt.headHash, &ckpt.tailHash);
+    close(fd);
+    if (!ok) return -1;
+
+    char path[512];
+    checkpointPath(output_dir, CB_COLUMN_FILE, path, sizeof(path));
+    if (fileIdentity(path, &ckpt.cbIno, &ckpt.cbSize) != 0) return -1;
+    checkpointPath(output_dir, IOSB_COLUMN_FILE, path, sizeof(path));
+    if (fileIdentity(path, &ckpt.iosbIno, &ckpt.iosbSize) != 0) return -1;
+
+    // Replace the previous checkpoint atomically
+    char tmpPath[560];
+    checkpointPath(output_dir, CKPT_FILE, path, sizeof(path));
+    snprintf(tmpPath, sizeof(tmpPath), "%s.%d.%lu.tmp", path, (int)getpid(),
+             __sync_fetch_and_add(&tmpCounter, 1));
+    FILE *fp = fopen(tmpPath, "wb");
+    if (!fp) return -1;
+    int failed = fwrite(&ckpt, sizeof(ckpt), 1, fp) != 1;
+    if (fclose(fp) != 0) failed = 1;
+    if (failed || rename(tmpPath, path) != 0) {
+        remove(tmpPath);
+        return -1;
+    }
+    return 0;
+}
+
+void removeCheckpoint(const char *output_dir)
+{
+    char path[512];
+    checkpointPath(output_dir, CKPT_FILE, path, sizeof(path));
+    remove(path);
+}
@@ -0,0 +1,276 @@
+// ColumnFile.c - Columnar binary container for billing results
+// Each metric is stored as its own contiguous array, so a reader can mmap the
+// file and scan one column (e.g. every MSISDN) without touching the others.
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../Header/ColumnFile.h"
+
+/* ============================================================
+   Writer
+   ============================================================ */
+
+int colSortedOutput(void)
+{
+    const char *env = getenv(COLFILE_SORTED_ENV);
+    return !(env && strcmp(env, "0") == 0);
+}
+
+static const char zeroPad[COLFILE_ALIGN];
+
+static int writeBytes(ColFileWriter *w, const void *data, size_t bytes)
+{
+    if (w->failed) return -1;
+    if (bytes && fwrite(data, 1, bytes, w->fp) != bytes) {
+        w->failed = 1;
+        return -1;
+    }
+    w->pos += bytes;
+    return 0;
+}
+
+static int padToAlign(ColFileWriter *w)
+{
+    size_t rem = (size_t)(w->pos % COLFILE_ALIGN);
+    return rem ? writeBytes(w, zeroPad, COLFILE_ALIGN - rem) : 0;
+}
+
+int colWriterOpen(ColFileWriter *w, const char *path, const char *kind,
+                  uint64_t rowCount, int columnCount, uint32_t fixedScale)
+{
+    static unsigned long tmpCounter = 0;
+
+    memset(w, 0, sizeof(*w));
+    if (columnCount < 1 || columnCount > COLFILE_MAX_COLUMNS) return -1;
+
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    snprintf(w->tmpPath, sizeof(w->tmpPath), "%s.%d.%lu.tmp", path, (int)getpid(),
+             __sync_fetch_and_add(&tmpCounter, 1));
+    w->fp = fopen(w->tmpPath, "wb");
+    if (!w->fp) {
+        fprintf(stderr, "Error creating output file '%s': %s\n", w->tmpPath, strerror(errno));
+        return -1;
+    }
+
+    memcpy(w->header.magic, COLFILE_MAGIC, sizeof(w->header.magic));
+    w->header.version = COLFILE_VERSION;
+    memcpy(w->header.kind, kind, strnlen(kind, sizeof(w->header.kind)));
+    w->header.rowCount = rowCount;
+    w->header.columnCount = 0;
+    w->header.fixedScale = fixedScale;
+    w->declared = columnCount;
+
+    // Reserve the header and directory; they are rewritten on close
+    writeBytes(w, &w->header, sizeof(w->header));
+    writeBytes(w, w->columns, sizeof(ColumnDesc) * (size_t)columnCount);
+    return w->failed ? -1 : 0;
+}
+
+int colWriterBegin(ColFileWriter *w, const char *name, ColType type, uint64_t rows)
+{
+    if ((int)w->header.columnCount >= w->declared) {
+        w->failed = 1;
+        return -1;
+    }
+    if (padToAlign(w) != 0) return -1;
+
+    ColumnDesc *c = &w->columns[w->header.columnCount];
+    memset(c, 0, sizeof(*c));
+    strncpy(c->name, name, sizeof(c->name) - 1);
+    c->type = (uint32_t)type;
+    c->rows = rows;
+    c->offset = w->pos;
+    return 0;
+}
+
+int colWriterPut(ColFileWriter *w, const void *data, size_t bytes)
+{
+    return writeBytes(w, data, bytes);
+}
+
+void colWriterSetFlags(ColFileWriter *w, uint32_t flags)
+{
+    if ((int)w->header.columnCount < w->declared)
+        w->columns[w->header.columnCount].flags = flags;
+}
+
+int colWriterEnd(ColFileWriter *w)
+{
+    if (w->failed) return -1;
+    ColumnDesc *c = &w->columns[w->header.columnCount];
+    c->size = w->pos - c->offset;
+    w->header.columnCount++;
+    return 0;
+}
+
+int colWriterStrings(ColFileWriter *w, const char *name,
+                     const char *const *strings, uint64_t rows)
+{
+    if (colWriterBegin(w, name, COL_STRING, rows) != 0) return -1;
+
+    uint64_t off = 0;
+    for (uint64_t i = 0; i < rows; i++) {
+        writeBytes(w, &off, sizeof(off));
+        off += strlen(strings[i]) + 1;
+    }
+    writeBytes(w, &off, sizeof(off));
+    for (uint64_t i = 0; i < rows; i++)
+        writeBytes(w, strings[i], strlen(strings[i]) + 1);
+
+    return colWriterEnd(w);
+}
+
+int colWriterClose(ColFileWriter *w)
+{
+    if (!w->fp) return -1;
+
+    // Every declared column must have been written
+    if ((int)w->header.columnCount != w->declared)
+        w->failed = 1;
+
+    if (!w->failed &&
+        (fseek(w->fp, 0, SEEK_SET) != 0 ||
+         fwrite(&w->header, sizeof(w->header), 1, w->fp) != 1 ||
+         fwrite(w->columns, sizeof(ColumnDesc), (size_t)w->declared, w->fp) != (size_t)w->declared))
+        w->failed = 1;
+
+    if (fclose(w->fp) != 0)
+        w->failed = 1;
+    w->fp = NULL;
+
+    // Readers see either the previous file or the complete new one
+    if (w->failed || rename(w->tmpPath, w->path) != 0) {
+        fprintf(stderr, "Error writing output file '%s': %s\n", w->path, strerror(errno));
+        remove(w->tmpPath);
+        return -1;
+    }
+    return 0;
+}
+
+/* ============================================================
+   Reader
+   ============================================================ */
+
+int colFileOpen(ColFile *f, const char *path, const char *kind)
+{
+    memset(f, 0, sizeof(*f));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ColFileHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const ColFileHeader *h = (const ColFileHeader *)map;
+    size_t dirEnd = sizeof(*h) + (size_t)h->columnCount * sizeof(ColumnDesc);
+    if (memcmp(h->magic, COLFILE_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != COLFILE_VERSION ||
+        strncmp(h->kind, kind, sizeof(h->kind)) != 0 ||
+        h->columnCount > COLFILE_MAX_COLUMNS ||
+        dirEnd > (size_t)st.st_size) {
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    f->map = map;
+    f->size = (size_t)st.st_size;
+    f->header = h;
+    f->columns = (const ColumnDesc *)((const char *)map + sizeof(*h));
+    f->dev = st.st_dev;
+    f->ino = st.st_ino;
+    return 0;
+}
+
+int colFileIsCurrent(const ColFile *f, const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 && st.st_dev == f->dev && st.st_ino == f->ino;
+}
+
+int colFileExportStale(const char *columnPath, const char *exportPath)
+{
+    struct stat col, out;
+    if (stat(columnPath, &col) != 0) return 0;
+    if (stat(exportPath, &out) != 0) return 1;
+    return out.st_mtim.tv_sec < col.st_mtim.tv_sec ||
+           (out.st_mtim.tv_sec == col.st_mtim.tv_sec && out.st_mtim.tv_nsec < col.st_mtim.tv_nsec);
+}
+
+void colFileClose(ColFile *f)
+{
+    if (f->map)
+        munmap(f->map, f->size);
+    memset(f, 0, sizeof(*f));
+}
+
+// A string column's offsets must start at 0, grow by at least one byte per
+// string (its NUL) and stay inside the column
+static int stringsValid(const ColumnDesc *c, const char *base)
+{
+    uint64_t head = (c->rows + 1) * sizeof(uint64_t);
+    if (c->size < head) return 0;
+
+    const uint64_t *offsets = (const uint64_t *)base;
+    const char *bytes = base + head;
+    if (offsets[0] != 0 || offsets[c->rows] > c->size - head) return 0;
+    for (uint64_t i = 0; i < c->rows; i++) {
+        // Bounded before it is dereferenced: later offsets are unchecked yet
+        if (offsets[i + 1] <= offsets[i] || offsets[i + 1] > offsets[c->rows])
+            return 0;
+        if (bytes[offsets[i + 1] - 1] != '\0')
+            return 0;
+    }
+    return 1;
+}
+
+int64_t colFileRows(const ColFile *f, const char *name)
+{
+    for (uint32_t i = 0; i < f->header->columnCount; i++)
+        if (strncmp(f->columns[i].name, name, sizeof(f->columns[i].name)) == 0)
+            return f->columns[i].rows <= f->size ? (int64_t)f->columns[i].rows : -1;
+    return -1;
+}
+
+uint32_t colFileFlags(const ColFile *f, const char *name)
+{
+    for (uint32_t i = 0; i < f->header->columnCount; i++)
+        if (strncmp(f->columns[i].name, name, sizeof(f->columns[i].name)) == 0)
+            return f->columns[i].flags;
+    return 0;
+}
+
+const void* colFileColumn(const ColFile *f, const char *name, ColType type, uint64_t rows)
+{
+    for (uint32_t i = 0; i < f->header->columnCount; i++) {
+        const ColumnDesc *c = &f->columns[i];
+        if (strncmp(c->name, name, sizeof(c->name)) != 0) continue;
+
+        if (c->type != (uint32_t)type || c->rows != rows || rows > f->size ||
+            c->offset % COLFILE_ALIGN != 0 ||
+            c->offset > f->size || c->size > f->size - c->offset)
+            return NULL;
+
+        const char *base = (const char *)f->map + c->offset;
+        uint64_t width = type == COL_INT64 ? 8 : type == COL_INT32 ? 4 : 0;
+        if (width && c->size != rows * width) return NULL;
+        if (type == COL_STRING && !stringsValid(c, base)) return NULL;
+        return base;
+    }
+    return NULL;
+}
+
+const char* colFileString(const void *column, uint64_t rows, uint64_t i)
+{
+    const uint64_t *offsets = (const uint64_t *)column;
+    const char *bytes = (const char *)column + (rows + 1) * sizeof(uint64_t);
+    return bytes + offsets[i];
+}
@@ -1,215 +1,1003 @@
 // CustBillProcess.c - Customer billing CDR processing
+// All aggregation state lives in the CustomerTable passed in by the caller
+// (normally the BillingJob of one processing run), so concurrent jobs never
+// share tables.
 #include "../Header/CustBillProcess.h"
+#include "../Header/process.h" // for BillingJob
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 /* ============================================================
-   Static Variables
+   Hash Function
    ============================================================ */
 
-static Customer *hashTable[HASH_SIZE];
-static int totalRecords = 0;
+// MurmurHash3 fmix64 finalizer: spreads sequential MSISDNs across all bits
+unsigned long hashFunction(long key)
+{
+    unsigned long long h = (unsigned long long)key;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return (unsigned long)h;
+}
 
 /* ============================================================
-   Hash Function
+   Open-Addressing Table (Internal)
    ============================================================ */
 
-unsigned int hashFunction(long key)
+// Index of the slot holding msisdn, or of the empty slot where it belongs
+static size_t probeSlot(const long *keys, size_t capacity, long msisdn)
 {
-    return (unsigned int)(key % HASH_SIZE);
+    size_t mask = capacity - 1;
+    size_t i = hashFunction(msisdn) & mask;
+    while (keys[i] != msisdn && keys[i] != CUST_EMPTY_KEY)
+        i = (i + 1) & mask;
+    return i;
+}
+
+// Rehash into a slot array twice the size (or the minimum size)
+static int growCustomerTable(CustomerTable *table)
+{
+    size_t newCap = table->capacity ? table->capacity * 2 : CUST_TABLE_MIN_CAPACITY;
+    long *keys = (long *)malloc(newCap * sizeof(long));
+    Customer *slots = (Customer *)malloc(newCap * sizeof(Customer));
+    if (!keys || !slots) {
+        free(keys);
+        free(slots);
+        return 0;
+    }
+    for (size_t i = 0; i < newCap; i++)
+        keys[i] = CUST_EMPTY_KEY;
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->keys[i] == CUST_EMPTY_KEY) continue;
+        size_t j = probeSlot(keys, newCap, table->keys[i]);
+        keys[j] = table->keys[i];
+        slots[j] = table->slots[i];
+    }
+
+    free(table->keys);
+    free(table->slots);
+    table->keys = keys;
+    table->slots = slots;
+    table->capacity = newCap;
+    return 1;
 }
 
 /* ============================================================
    Customer Management Functions
    ============================================================ */
 
-Customer* createCustomer(long msisdn, const char *operatorName, int operatorCode)
+static void initCustomer(Customer *cust, long msisdn, const char *operatorName,
+                         int operatorCode)
 {
-    Customer *cust = (Customer *)malloc(sizeof(Customer));
-    if (!cust) return NULL;
-    
-    // Initialize customer data
+    memset(cust, 0, sizeof(*cust));
     cust->msisdn = msisdn;
-    strncpy(cust->operatorName, operatorName, sizeof(cust->operatorName) - 1);
-    cust->operatorName[sizeof(cust->operatorName) - 1] = '\0';
+    cust->operatorName = operatorName;
     cust->operatorCode = operatorCode;
-    
-    // Initialize all counters to zero
-    cust->inVoiceWithin = cust->outVoiceWithin = 0;
-    cust->inVoiceOutside = cust->outVoiceOutside = 0;
-    cust->smsInWithin = cust->smsOutWithin = 0;
-    cust->smsInOutside = cust->smsOutOutside = 0;
-    cust->mbDownload = cust->mbUpload = 0;
-    cust->next = NULL;
-    
-    return cust;
 }
 
-Customer* getCustomer(long msisdn, const char *operatorName, int operatorCode)
+Customer* findCustomer(const CustomerTable *table, long msisdn)
 {
-    unsigned int index = hashFunction(msisdn);
-    Customer *curr = hashTable[index];
-    
-    // Search for existing customer in chain
-    while (curr) {
-        if (curr->msisdn == msisdn)
-            return curr;
-        curr = curr->next;
-    }
-    
-    // Customer not found - create new one and add to hash table
-    Customer *newCust = createCustomer(msisdn, operatorName, operatorCode);
-    if (newCust) {
-        newCust->next = hashTable[index];
-        hashTable[index] = newCust;
-    }
-    
-    return newCust;
+    if (table->capacity == 0 || msisdn == CUST_EMPTY_KEY) return NULL;
+
+    size_t i = probeSlot(table->keys, table->capacity, msisdn);
+    return table->keys[i] == msisdn ? &table->slots[i] : NULL;
+}
+
+Customer* getCustomer(CustomerTable *table, long msisdn, const char *operatorName,
+                      size_t nameLen, int operatorCode)
+{
+    if (msisdn == CUST_EMPTY_KEY) return NULL;
+
+    // Keep the load factor bounded so probe runs stay short
+    if ((table->count + 1) * 100 > table->capacity * CUST_TABLE_MAX_LOAD &&
+        !growCustomerTable(table))
+        return NULL;
+
+    size_t i = probeSlot(table->keys, table->capacity, msisdn);
+    if (table->keys[i] == msisdn)
+        return &table->slots[i];
+
+    // Customer not found - intern the operator name (a view, not
+    // NUL-terminated) and claim the empty slot
+    if (nameLen > CUST_NAME_MAX)
+        nameLen = CUST_NAME_MAX;
+    const char *name = arenaIntern(&table->arena, operatorName, nameLen);
+    if (!name) return NULL;
+
+    table->keys[i] = msisdn;
+    table->count++;
+    initCustomer(&table->slots[i], msisdn, name, operatorCode);
+    return &table->slots[i];
 }
 
 /* ============================================================
    Helper Functions (Internal)
    ============================================================ */
 
-static void updateCustomerStats(Customer *cust, const char *callType, 
-                                int sameOperator, float duration, 
-                                float download, float upload)
+static void updateCustomerStats(Customer *cust, CDRCallType callType,
+                                int sameOperator, long long duration,
+                                long long download, long long upload)
 {
-    if (strcmp(callType, "MOC") == 0) {
-        sameOperator ? (cust->outVoiceWithin += duration) 
-                    : (cust->outVoiceOutside += duration);
-    }
-    else if (strcmp(callType, "MTC") == 0) {
-        sameOperator ? (cust->inVoiceWithin += duration) 
-                    : (cust->inVoiceOutside += duration);
-    }
-    else if (strcmp(callType, "SMS-MO") == 0) {
+    switch (callType) {
+    case CDR_CALL_MOC:
+        sameOperator ? (cust->outVoiceWithin += duration)
+                     : (cust->outVoiceOutside += duration);
+        break;
+    case CDR_CALL_MTC:
+        sameOperator ? (cust->inVoiceWithin += duration)
+                     : (cust->inVoiceOutside += duration);
+        break;
+    case CDR_CALL_SMS_MO:
         sameOperator ? cust->smsOutWithin++ : cust->smsOutOutside++;
-    }
-    else if (strcmp(callType, "SMS-MT") == 0) {
+        break;
+    case CDR_CALL_SMS_MT:
         sameOperator ? cust->smsInWithin++ : cust->smsInOutside++;
-    }
-    else if (strcmp(callType, "GPRS") == 0) {
+        break;
+    case CDR_CALL_GPRS:
         cust->mbDownload += download;
         cust->mbUpload += upload;
+        break;
+    default:
+        break;
     }
 }
 
 /* ============================================================
-   CDR File Processing
+   CDR Record Aggregation
    ============================================================ */
 
-void processCDRFile(const char *filename)
+void customerConsumeRecord(const CDRRecord *rec, void *ctx)
 {
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
-        fprintf(stderr, "Error opening CDR file '%s': %s\n", filename, strerror(errno));
+    CustomerTable *table = (CustomerTable *)ctx;
+
+    // Skip lines whose numeric fields did not parse
+    if (!rec->typedValid) return;
+
+    // Get or create customer record
+    CDRField opName = rec->fields[1];
+    Customer *cust = getCustomer(table, rec->msisdn, opName.ptr, opName.len,
+                                 rec->operatorCode);
+    if (!cust) return;
+
+    // Determine if call is within same operator
+    int sameOperator = (rec->operatorCode == rec->thirdPartyOpCode);
+
+    // Update customer statistics with the exact fixed-point volumes.
+    // Only the canonical upper-case call type spellings are billed here.
+    updateCustomerStats(cust, rec->callTypeExact ? rec->callType : CDR_CALL_UNKNOWN,
+                        sameOperator, rec->duration, rec->download, rec->upload);
+
+    table->totalRecords++;
+}
+
+/* ============================================================
+   Partial Table Merge
+   ============================================================ */
+
+static void addCustomerStats(Customer *dst, const Customer *src)
+{
+    dst->inVoiceWithin += src->inVoiceWithin;
+    dst->outVoiceWithin += src->outVoiceWithin;
+    dst->inVoiceOutside += src->inVoiceOutside;
+    dst->outVoiceOutside += src->outVoiceOutside;
+    dst->smsInWithin += src->smsInWithin;
+    dst->smsOutWithin += src->smsOutWithin;
+    dst->smsInOutside += src->smsInOutside;
+    dst->smsOutOutside += src->smsOutOutside;
+    dst->mbDownload += src->mbDownload;
+    dst->mbUpload += src->mbUpload;
+}
+
+void mergeCustomerTable(CustomerTable *dst, CustomerTable *src)
+{
+    // First partial into an empty table: take its slot arrays as they are
+    if (dst->count == 0) {
+        long totalRecords = dst->totalRecords + src->totalRecords;
+        freeCustomerTable(dst);
+        *dst = *src;
+        dst->totalRecords = totalRecords;
+        memset(src, 0, sizeof(*src));
         return;
     }
-    
-    char line[512];
-    totalRecords = 0;
-    
-    while (fgets(line, sizeof(line), fp)) {
-        // Remove newline characters
-        line[strcspn(line, "\r\n")] = 0;
-        
-        // Initialize CDR fields
-        long msisdn = 0, thirdPartyMsisdn = 0;
-        char opName[64] = {0}, callType[16] = {0};
-        int opCode = 0, thirdPartyOpCode = 0;
-        float duration = 0, download = 0, upload = 0;
-        
-        // Parse CDR line (9 fields expected)
-        int matched = sscanf(line, "%ld|%63[^|]|%d|%15[^|]|%f|%f|%f|%ld|%d",
-                            &msisdn, opName, &opCode, callType,
-                            &duration, &download, &upload,
-                            &thirdPartyMsisdn, &thirdPartyOpCode);
-        
-        // Handle edge case: GPRS records with empty third party MSISDN (||)
-        if (matched < 9) {
-            matched = sscanf(line, "%ld|%63[^|]|%d|%15[^|]|%f|%f|%f||%d",
-                            &msisdn, opName, &opCode, callType,
-                            &duration, &download, &upload, &thirdPartyOpCode);
-            if (matched < 8) continue; // Skip invalid lines
+
+    for (size_t i = 0; i < src->capacity; i++) {
+        if (src->keys[i] == CUST_EMPTY_KEY) continue;
+
+        Customer *c = &src->slots[i];
+        Customer *found = findCustomer(dst, c->msisdn);
+        if (found) {
+            // Existing customer keeps its first-seen operator name
+            addCustomerStats(found, c);
+        } else {
+            // Re-interning the name is a hit after the first customer of
+            // each operator, so this costs no arena space per customer
+            Customer *fresh = getCustomer(dst, c->msisdn, c->operatorName,
+                                          strlen(c->operatorName), c->operatorCode);
+            if (fresh) addCustomerStats(fresh, c);
         }
-        
-        // Get or create customer record
-        Customer *cust = getCustomer(msisdn, opName, opCode);
-        if (!cust) continue;
-        
-        // Determine if call is within same operator
-        int sameOperator = (opCode == thirdPartyOpCode);
-        
-        // Update customer statistics
-        updateCustomerStats(cust, callType, sameOperator, duration, download, upload);
-        
-        totalRecords++;
     }
-    
-    fclose(fp);
+
+    dst->totalRecords += src->totalRecords;
+    freeCustomerTable(src);
 }
 
-static void writeCustomerRecord(FILE *fp, Customer *cust)
+int copyCustomerTable(CustomerTable *dst, const CustomerTable *src)
 {
-    fprintf(fp, "\nCustomer ID: %ld (%s)\n", cust->msisdn, cust->operatorName);
-    fprintf(fp, "* Services within the mobile operator *\n");
-    fprintf(fp, "Incoming voice call durations: %.2f\n", cust->inVoiceWithin);
-    fprintf(fp, "Outgoing voice call durations: %.2f\n", cust->outVoiceWithin);
-    fprintf(fp, "Incoming SMS messages: %d\n", cust->smsInWithin);
-    fprintf(fp, "Outgoing SMS messages: %d\n", cust->smsOutWithin);
-    fprintf(fp, "* Services outside the mobile operator *\n");
-    fprintf(fp, "Incoming voice call durations: %.2f\n", cust->inVoiceOutside);
-    fprintf(fp, "Outgoing voice call durations: %.2f\n", cust->outVoiceOutside);
-    fprintf(fp, "Incoming SMS messages: %d\n", cust->smsInOutside);
-    fprintf(fp, "Outgoing SMS messages: %d\n", cust->smsOutOutside);
-    fprintf(fp, "* Internet use *\n");
-    fprintf(fp, "MB downloaded: %.2f | MB uploaded: %.2f\n",
-            cust->mbDownload, cust->mbUpload);
-    fprintf(fp, "----------------------------------------\n");
+    freeCustomerTable(dst);
+    dst->totalRecords = src->totalRecords;
+    if (src->capacity == 0) return 0;
+
+    // Same slot layout, so the copy iterates (and reports) like the source
+    dst->keys = (long *)malloc(src->capacity * sizeof(long));
+    dst->slots = (Customer *)malloc(src->capacity * sizeof(Customer));
+    if (!dst->keys || !dst->slots) {
+        freeCustomerTable(dst);
+        return -1;
+    }
+    memcpy(dst->keys, src->keys, src->capacity * sizeof(long));
+    memcpy(dst->slots, src->slots, src->capacity * sizeof(Customer));
+    dst->capacity = src->capacity;
+    dst->count = src->count;
+
+    // Names point into the source arena: intern them into the copy's own
+    for (size_t i = 0; i < dst->capacity; i++) {
+        if (dst->keys[i] == CUST_EMPTY_KEY) continue;
+        Customer *c = &dst->slots[i];
+        c->operatorName = arenaIntern(&dst->arena, c->operatorName, strlen(c->operatorName));
+        if (!c->operatorName) {
+            freeCustomerTable(dst);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void emitCustomerRecord(ReportWriter *w, const Customer *cust)
+{
+    // Totals are exact until here: round to 2 decimals only for display
+    reportPutLit(w, "\nCustomer ID: ");
+    reportPutLong(w, cust->msisdn);
+    reportPutLit(w, " (");
+    reportPutStr(w, cust->operatorName);
+    reportPutLit(w, ")\n* Services within the mobile operator *\nIncoming voice call durations: ");
+    reportPutFixed(w, cust->inVoiceWithin, 2);
+    reportPutLit(w, "\nOutgoing voice call durations: ");
+    reportPutFixed(w, cust->outVoiceWithin, 2);
+    reportPutLit(w, "\nIncoming SMS messages: ");
+    reportPutLong(w, cust->smsInWithin);
+    reportPutLit(w, "\nOutgoing SMS messages: ");
+    reportPutLong(w, cust->smsOutWithin);
+    reportPutLit(w, "\n* Services outside the mobile operator *\nIncoming voice call durations: ");
+    reportPutFixed(w, cust->inVoiceOutside, 2);
+    reportPutLit(w, "\nOutgoing voice call durations: ");
+    reportPutFixed(w, cust->outVoiceOutside, 2);
+    reportPutLit(w, "\nIncoming SMS messages: ");
+    reportPutLong(w, cust->smsInOutside);
+    reportPutLit(w, "\nOutgoing SMS messages: ");
+    reportPutLong(w, cust->smsOutOutside);
+    reportPutLit(w, "\n* Internet use *\nMB downloaded: ");
+    reportPutFixed(w, cust->mbDownload, 2);
+    reportPutLit(w, " | MB uploaded: ");
+    reportPutFixed(w, cust->mbUpload, 2);
+    reportPutLit(w, "\n----------------------------------------\n");
+}
+
+int formatCustomerRecord(char *buf, size_t size, const Customer *cust)
+{
+    ReportWriter w;
+    reportWriterInitBuffer(&w, buf, size);
+    emitCustomerRecord(&w, cust);
+    reportWriterFinishBuffer(&w);
+    return (int)w.offset;
 }
 
 /* ============================================================
    Output Generation
    ============================================================ */
 
-void writeCBFile(const char *outputFile)
+// Write the index to a temporary file and rename it into place, so readers
+// see either the previous index or the complete new one
+static void writeCBIndex(const char *indexFile, const CBIndexEntry *entries,
+                         size_t capacity, size_t count, uint64_t reportSize)
 {
-    FILE *fp = fopen(outputFile, "w");
+    char tmpPath[512];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", indexFile);
+
+    FILE *fp = fopen(tmpPath, "wb");
     if (!fp) {
-        fprintf(stderr, "Error creating output file '%s': %s\n", outputFile, strerror(errno));
+        fprintf(stderr, "Error creating index file '%s': %s\n", tmpPath, strerror(errno));
         return;
     }
-    
-    fprintf(fp, "#Customers Data Base:\n");
-    
-    // Iterate through hash table and write all customer records
-    int customerCount = 0;
-    for (int i = 0; i < HASH_SIZE; i++) {
-        Customer *cust = hashTable[i];
-        while (cust) {
-            writeCustomerRecord(fp, cust);
-            customerCount++;
-            cust = cust->next;
+
+    CBIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CB_INDEX_MAGIC, sizeof(header.magic));
+    header.version = CB_INDEX_VERSION;
+    header.capacity = capacity;
+    header.count = count;
+    header.reportSize = reportSize;
+
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(entries, sizeof(CBIndexEntry), capacity, fp) == capacity;
+    ok = (fclose(fp) == 0) && ok;
+
+    if (!ok || rename(tmpPath, indexFile) != 0) {
+        fprintf(stderr, "Error writing index file '%s': %s\n", indexFile, strerror(errno));
+        remove(tmpPath);
+    }
+}
+
+/* ============================================================
+   Columnar Output
+   ============================================================ */
+
+// Counter columns of CB.col, in Customer field order
+typedef enum { FIELD_LONG, FIELD_LONGLONG } FieldKind;
+
+static const struct {
+    const char *name;
+    size_t offset;
+    FieldKind kind;
+} metricColumns[CB_METRIC_COUNT] = {
+    { "in_voice_within",   offsetof(Customer, inVoiceWithin),   FIELD_LONGLONG },
+    { "out_voice_within",  offsetof(Customer, outVoiceWithin),  FIELD_LONGLONG },
+    { "in_voice_outside",  offsetof(Customer, inVoiceOutside),  FIELD_LONGLONG },
+    { "out_voice_outside", offsetof(Customer, outVoiceOutside), FIELD_LONGLONG },
+    { "sms_in_within",     offsetof(Customer, smsInWithin),     FIELD_LONG },
+    { "sms_out_within",    offsetof(Customer, smsOutWithin),    FIELD_LONG },
+    { "sms_in_outside",    offsetof(Customer, smsInOutside),    FIELD_LONG },
+    { "sms_out_outside",   offsetof(Customer, smsOutOutside),   FIELD_LONG },
+    { "mb_download",       offsetof(Customer, mbDownload),      FIELD_LONGLONG },
+    { "mb_upload",         offsetof(Customer, mbUpload),        FIELD_LONGLONG },
+};
+
+static int64_t metricValue(const Customer *cust, int m)
+{
+    const char *field = (const char *)cust + metricColumns[m].offset;
+    return metricColumns[m].kind == FIELD_LONG ? (int64_t)*(const long *)field
+                                               : (int64_t)*(const long long *)field;
+}
+
+static void setMetricValue(Customer *cust, int m, int64_t value)
+{
+    char *field = (char *)cust + metricColumns[m].offset;
+    if (metricColumns[m].kind == FIELD_LONG)
+        *(long *)field = (long)value;
+    else
+        *(long long *)field = (long long)value;
+}
+
+// Operator name dictionary: interned names are unique pointers, so rows map
+// to dictionary indexes through a small pointer-keyed open-addressing table
+typedef struct {
+    const char **names;     // dictionary, in first-use order
+    size_t count;
+    const char **keys;      // probe table (NULL = free)
+    uint32_t *index;
+    size_t capacity;        // power of two, kept at most half full
+} NameDict;
+
+static int dictGrow(NameDict *d)
+{
+    size_t cap = d->capacity ? d->capacity * 2 : 64;
+    const char **keys = (const char **)calloc(cap, sizeof(*keys));
+    uint32_t *index = (uint32_t *)malloc(cap * sizeof(*index));
+    const char **names = (const char **)realloc(d->names, (cap / 2) * sizeof(*names));
+    if (!keys || !index || !names) {
+        free(keys);
+        free(index);
+        if (names) d->names = names;
+        return 0;
+    }
+    d->names = names;
+
+    for (size_t i = 0; i < d->capacity; i++) {
+        if (!d->keys[i]) continue;
+        size_t j = hashFunction((long)(uintptr_t)d->keys[i]) & (cap - 1);
+        while (keys[j])
+            j = (j + 1) & (cap - 1);
+        keys[j] = d->keys[i];
+        index[j] = d->index[i];
+    }
+    free(d->keys);
+    free(d->index);
+    d->keys = keys;
+    d->index = index;
+    d->capacity = cap;
+    return 1;
+}
+
+// Dictionary index of name, adding it on first use; -1 on allocation failure
+static int64_t dictIndex(NameDict *d, const char *name)
+{
+    if ((d->count + 1) * 2 > d->capacity && !dictGrow(d))
+        return -1;
+
+    size_t mask = d->capacity - 1;
+    size_t i = hashFunction((long)(uintptr_t)name) & mask;
+    while (d->keys[i] && d->keys[i] != name)
+        i = (i + 1) & mask;
+    if (!d->keys[i]) {
+        d->keys[i] = name;
+        d->index[i] = (uint32_t)d->count;
+        d->names[d->count++] = name;
+    }
+    return d->index[i];
+}
+
+static void dictFree(NameDict *d)
+{
+    free(d->names);
+    free(d->keys);
+    free(d->index);
+    memset(d, 0, sizeof(*d));
+}
+
+// Run fn over count items, item 0 on the calling thread
+static void runWorkers(void *(*fn)(void *), void *items, size_t itemSize, int count)
+{
+    pthread_t tids[CDR_MAX_WORKERS];
+    int started[CDR_MAX_WORKERS] = {0};
+    char *base = (char *)items;
+    for (int i = 1; i < count; i++)
+        started[i] = (pthread_create(&tids[i], NULL, fn, base + (size_t)i * itemSize) == 0);
+    fn(base);
+
+    for (int i = 1; i < count; i++) {
+        if (started[i])
+            pthread_join(tids[i], NULL);
+        else
+            fn(base + (size_t)i * itemSize); // could not spawn: run it here
+    }
+}
+
+// Values are staged in a chunk so each column costs a few large writes
+#define CB_COLUMN_CHUNK 4096
+
+// Customer of one occupied slot, as sorted within a run
+typedef struct {
+    long msisdn;
+    size_t slot;
+} SortKey;
+
+// One worker's sorted run: the occupied slots of a slot range
+typedef struct {
+    const CustomerTable *table;
+    size_t firstSlot, lastSlot;
+    SortKey *keys;          // run storage (its part of a shared array)
+    size_t count;
+    size_t next;            // merge position
+} SortRun;
+
+static int compareSortKey(const void *a, const void *b)
+{
+    long x = ((const SortKey *)a)->msisdn;
+    long y = ((const SortKey *)b)->msisdn;
+    return (x > y) - (x < y);
+}
+
+static void* sortRunThread(void *arg)
+{
+    SortRun *run = (SortRun *)arg;
+    size_t n = 0;
+    for (size_t i = run->firstSlot; i < run->lastSlot; i++) {
+        if (run->table->keys[i] == CUST_EMPTY_KEY) continue;
+        run->keys[n].msisdn = run->table->keys[i];
+        run->keys[n].slot = i;
+        n++;
+    }
+    qsort(run->keys, n, sizeof(SortKey), compareSortKey);
+    return NULL;
+}
+
+// Restore the heap property below position i (heap of run indexes ordered
+// by each run's next MSISDN)
+static void siftDown(int *heap, int size, const SortRun *runs, int i)
+{
+    for (;;) {
+        int least = i, l = 2 * i + 1, r = l + 1;
+        if (l < size && runs[heap[l]].keys[runs[heap[l]].next].msisdn <
+                        runs[heap[least]].keys[runs[heap[least]].next].msisdn)
+            least = l;
+        if (r < size && runs[heap[r]].keys[runs[heap[r]].next].msisdn <
+                        runs[heap[least]].keys[runs[heap[least]].next].msisdn)
+            least = r;
+        if (least == i) return;
+        int t = heap[i];
+        heap[i] = heap[least];
+        heap[least] = t;
+        i = least;
+    }
+}
+
+// Produce the CB.col row order as slot indexes and stream the msisdn column
+// into w on the way. Rows are in ascending MSISDN order when sorted output
+// is on: every worker sorts the occupied slots of its slot range, and the
+// runs are combined by a k-way merge. Otherwise rows follow slot order.
+// The runs are kept in memory rather than spilled: the table they index is
+// resident anyway and every other column needs the full row order, so the
+// sort costs one SortKey per customer on top of it until the merge ends.
+// Returns NULL on allocation failure.
+static size_t* writeRowOrder(ColFileWriter *w, const CustomerTable *table, int sorted)
+{
+    size_t *order = (size_t *)malloc((table->count ? table->count : 1) * sizeof(size_t));
+    if (!order) return NULL;
+
+    int64_t chunk[CB_COLUMN_CHUNK];
+    size_t n = 0, row = 0;
+    colWriterBegin(w, "msisdn", COL_INT64, table->count);
+    if (sorted)
+        colWriterSetFlags(w, COLFILE_FLAG_SORTED); // MSISDNs are unique
+
+    if (!sorted) {
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (table->keys[i] == CUST_EMPTY_KEY) continue;
+            order[row++] = i;
+            chunk[n++] = table->keys[i];
+            if (n == CB_COLUMN_CHUNK) {
+                colWriterPut(w, chunk, n * sizeof(int64_t));
+                n = 0;
+            }
         }
+    } else {
+        SortKey *keys = (SortKey *)malloc((table->count ? table->count : 1) * sizeof(SortKey));
+        if (!keys) {
+            free(order);
+            return NULL;
+        }
+
+        // Slot ranges with their occupied counts, so each run knows its
+        // part of the shared key array
+        int workers = cdrWorkerCount();
+        if ((size_t)workers > table->count / CB_EXPORT_MIN_ROWS + 1)
+            workers = (int)(table->count / CB_EXPORT_MIN_ROWS + 1);
+        SortRun runs[CDR_MAX_WORKERS];
+        size_t used = 0;
+        for (int r = 0; r < workers; r++) {
+            SortRun *run = &runs[r];
+            run->table = table;
+            run->firstSlot = table->capacity * (size_t)r / (size_t)workers;
+            run->lastSlot = table->capacity * (size_t)(r + 1) / (size_t)workers;
+            run->count = 0;
+            for (size_t i = run->firstSlot; i < run->lastSlot; i++)
+                run->count += (table->keys[i] != CUST_EMPTY_KEY);
+            run->keys = keys + used;
+            run->next = 0;
+            used += run->count;
+        }
+        runWorkers(sortRunThread, runs, sizeof(SortRun), workers);
+
+        // k-way merge of the runs through a min-heap of their heads
+        int heap[CDR_MAX_WORKERS];
+        int size = 0;
+        for (int r = 0; r < workers; r++)
+            if (runs[r].count) heap[size++] = r;
+        for (int i = size / 2 - 1; i >= 0; i--)
+            siftDown(heap, size, runs, i);
+
+        while (size > 0) {
+            SortRun *run = &runs[heap[0]];
+            const SortKey *k = &run->keys[run->next++];
+            order[row++] = k->slot;
+            chunk[n++] = k->msisdn;
+            if (n == CB_COLUMN_CHUNK) {
+                colWriterPut(w, chunk, n * sizeof(int64_t));
+                n = 0;
+            }
+            if (run->next == run->count)
+                heap[0] = heap[--size];
+            siftDown(heap, size, runs, 0);
+        }
+        free(keys);
     }
-    
-    fclose(fp);
+
+    colWriterPut(w, chunk, n * sizeof(int64_t));
+    colWriterEnd(w);
+    return order;
+}
+
+int writeCBColumns(const CustomerTable *table, const char *columnFile)
+{
+    ColFileWriter w;
+    if (colWriterOpen(&w, columnFile, CB_COLUMN_KIND, table->count,
+                      4 + CB_METRIC_COUNT, CDR_FIXED_SCALE) != 0)
+        return -1;
+
+    // Row order (and the msisdn column) first; every other column follows it
+    size_t *order = writeRowOrder(&w, table, colSortedOutput());
+    NameDict dict;
+    memset(&dict, 0, sizeof(dict));
+    int32_t *opIndex = (int32_t *)malloc((table->count ? table->count : 1) * sizeof(int32_t));
+    int ok = order && opIndex;
+
+    for (size_t row = 0; row < table->count && ok; row++) {
+        int64_t idx = dictIndex(&dict, table->slots[order[row]].operatorName);
+        ok = idx >= 0;
+        opIndex[row] = (int32_t)idx;
+    }
+    if (!ok) {
+        w.failed = 1;
+        colWriterClose(&w);
+        free(order);
+        free(opIndex);
+        dictFree(&dict);
+        return -1;
+    }
+
+    // operator (dictionary index)
+    colWriterBegin(&w, "operator", COL_INT32, table->count);
+    colWriterPut(&w, opIndex, table->count * sizeof(int32_t));
+    colWriterEnd(&w);
+
+    // operator_code (reuses the index buffer)
+    for (size_t row = 0; row < table->count; row++)
+        opIndex[row] = table->slots[order[row]].operatorCode;
+    colWriterBegin(&w, "operator_code", COL_INT32, table->count);
+    colWriterPut(&w, opIndex, table->count * sizeof(int32_t));
+    colWriterEnd(&w);
+
+    // Counters, one column each
+    int64_t chunk[CB_COLUMN_CHUNK];
+    for (int m = 0; m < CB_METRIC_COUNT; m++) {
+        colWriterBegin(&w, metricColumns[m].name, COL_INT64, table->count);
+        size_t n = 0;
+        for (size_t row = 0; row < table->count; row++) {
+            chunk[n++] = metricValue(&table->slots[order[row]], m);
+            if (n == CB_COLUMN_CHUNK) {
+                colWriterPut(&w, chunk, n * sizeof(int64_t));
+                n = 0;
+            }
+        }
+        colWriterPut(&w, chunk, n * sizeof(int64_t));
+        colWriterEnd(&w);
+    }
+
+    colWriterStrings(&w, "operator_names", dict.names, dict.count);
+
+    free(order);
+    free(opIndex);
+    dictFree(&dict);
+    return colWriterClose(&w);
 }
 
 /* ============================================================
-   Memory Management
+   Columnar Input
    ============================================================ */
 
-void cleanupHashTable(void)
+int openCBColumns(CBColumns *cols, const char *columnFile)
+{
+    memset(cols, 0, sizeof(*cols));
+    if (colFileOpen(&cols->file, columnFile, CB_COLUMN_KIND) != 0)
+        return -1;
+
+    const ColFile *f = &cols->file;
+    uint64_t rows = f->header->rowCount;
+    int64_t names = colFileRows(f, "operator_names");
+
+    cols->rows = rows;
+    cols->msisdn = (const int64_t *)colFileColumn(f, "msisdn", COL_INT64, rows);
+    cols->operatorIndex = (const int32_t *)colFileColumn(f, "operator", COL_INT32, rows);
+    cols->operatorCode = (const int32_t *)colFileColumn(f, "operator_code", COL_INT32, rows);
+    cols->operatorCount = names > 0 ? (uint64_t)names : 0;
+    cols->operatorNames = names >= 0 ? colFileColumn(f, "operator_names", COL_STRING,
+                                                     (uint64_t)names) : NULL;
+
+    int ok = cols->msisdn && cols->operatorIndex && cols->operatorCode && cols->operatorNames;
+    for (int m = 0; m < CB_METRIC_COUNT && ok; m++) {
+        cols->metrics[m] = (const int64_t *)colFileColumn(f, metricColumns[m].name, COL_INT64, rows);
+        ok = cols->metrics[m] != NULL;
+    }
+
+    // Files written with sorted output can be binary searched. Nothing here
+    // is O(rows): a lookup touches only the rows it needs.
+    cols->sorted = (colFileFlags(f, "msisdn") & COLFILE_FLAG_SORTED) != 0;
+
+    if (!ok) {
+        closeCBColumns(cols);
+        return -1;
+    }
+    return 0;
+}
+
+void closeCBColumns(CBColumns *cols)
+{
+    colFileClose(&cols->file);
+    memset(cols, 0, sizeof(*cols));
+}
+
+int64_t findCBColumnRow(const CBColumns *cols, long msisdn)
 {
-    for (int i = 0; i < HASH_SIZE; i++) {
-        Customer *cust = hashTable[i];
-        while (cust) {
-            Customer *temp = cust;
-            cust = cust->next;
-            free(temp);
+    const int64_t *keys = cols->msisdn;
+    if (cols->sorted) {
+        uint64_t lo = 0, hi = cols->rows;
+        while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if (keys[mid] < msisdn)
+                lo = mid + 1;
+            else
+                hi = mid;
         }
-        hashTable[i] = NULL;
+        return (lo < cols->rows && keys[lo] == msisdn) ? (int64_t)lo : -1;
+    }
+
+    // Plain loop over one contiguous column: the compiler vectorizes it
+    for (uint64_t i = 0; i < cols->rows; i++)
+        if (keys[i] == msisdn)
+            return (int64_t)i;
+    return -1;
+}
+
+int loadCBColumnRow(const CBColumns *cols, uint64_t row, Customer *cust)
+{
+    // Dictionary references must be in range
+    int32_t op = cols->operatorIndex[row];
+    if (op < 0 || (uint64_t)op >= cols->operatorCount) return -1;
+
+    memset(cust, 0, sizeof(*cust));
+    cust->msisdn = (long)cols->msisdn[row];
+    cust->operatorName = colFileString(cols->operatorNames, cols->operatorCount, (uint64_t)op);
+    cust->operatorCode = cols->operatorCode[row];
+    for (int m = 0; m < CB_METRIC_COUNT; m++)
+        setMetricValue(cust, m, cols->metrics[m][row]);
+    return 0;
+}
+
+int loadCBColumnsInto(CustomerTable *table, const char *columnFile)
+{
+    CBColumns cols;
+    if (openCBColumns(&cols, columnFile) != 0) return -1;
+
+    int failed = 0;
+    for (uint64_t row = 0; row < cols.rows && !failed; row++) {
+        Customer saved;
+        Customer *cust = NULL;
+        if (loadCBColumnRow(&cols, row, &saved) == 0)
+            cust = getCustomer(table, saved.msisdn, saved.operatorName,
+                               strlen(saved.operatorName), saved.operatorCode);
+        if (cust)
+            addCustomerStats(cust, &saved);
+        else
+            failed = 1;
     }
+
+    closeCBColumns(&cols);
+    return failed ? -1 : 0;
+}
+
+/* ============================================================
+   Text Export
+   ============================================================ */
+
+// Length of the values in a customer's CB.txt record; the rest of the
+// record is the same for every customer (see recordOverhead)
+static uint64_t recordValueLength(const Customer *cust)
+{
+    return reportLongLength(cust->msisdn) + strlen(cust->operatorName) +
+           reportFixedLength(cust->inVoiceWithin, 2) + reportFixedLength(cust->outVoiceWithin, 2) +
+           reportLongLength(cust->smsInWithin) + reportLongLength(cust->smsOutWithin) +
+           reportFixedLength(cust->inVoiceOutside, 2) + reportFixedLength(cust->outVoiceOutside, 2) +
+           reportLongLength(cust->smsInOutside) + reportLongLength(cust->smsOutOutside) +
+           reportFixedLength(cust->mbDownload, 2) + reportFixedLength(cust->mbUpload, 2);
+}
+
+// Bytes of emitCustomerRecord's fixed text, measured once on an empty record
+static uint64_t recordOverhead(void)
+{
+    Customer empty;
+    memset(&empty, 0, sizeof(empty));
+    empty.operatorName = "";
+    ReportWriter w;
+    reportWriterInitBuffer(&w, NULL, 0);
+    emitCustomerRecord(&w, &empty);
+    return w.offset - recordValueLength(&empty);
+}
+
+// One export worker's share of CB.txt: a contiguous range of rows
+typedef struct {
+    const CBColumns *cols;
+    uint64_t first, last;   // rows [first, last)
+    int fd;                 // output file, -1 to only measure the range
+    uint64_t base;          // file offset of the range's first record
+    uint64_t bytes;         // text length of the range
+    uint64_t overhead;      // recordOverhead(), for measuring
+    uint32_t *lengths;      // each row's record length
+    int measured;           // lengths were filled in by a measuring pass
+    int failed;
+} ExportRange;
+
+static void* exportRangeThread(void *arg)
+{
+    ExportRange *r = (ExportRange *)arg;
+    if (r->failed) return NULL; // the measuring pass already gave up
+    r->bytes = 0;
+
+    if (r->fd < 0) {
+        // Measure only: record lengths follow from the values, nothing is formatted
+        for (uint64_t row = r->first; row < r->last; row++) {
+            Customer cust;
+            if (loadCBColumnRow(r->cols, row, &cust) != 0) {
+                r->failed = 1; // corrupt row: the export is discarded
+                break;
+            }
+            uint64_t length = r->overhead + recordValueLength(&cust);
+            r->lengths[row] = (uint32_t)length;
+            r->bytes += length;
+        }
+        return NULL;
+    }
+
+    // Format the range once, pwriting it from its final offset through the
+    // writer's fixed-size buffer
+    ReportWriter w;
+    if (reportWriterOpenAt(&w, r->fd, r->base) != 0) {
+        r->failed = 1;
+        return NULL;
+    }
+    for (uint64_t row = r->first; row < r->last && !w.failed; row++) {
+        Customer cust;
+        if (loadCBColumnRow(r->cols, row, &cust) != 0) {
+            w.failed = 1;
+            break;
+        }
+        uint64_t start = w.offset;
+        emitCustomerRecord(&w, &cust);
+        uint32_t length = (uint32_t)(w.offset - start);
+        if (r->measured && length != r->lengths[row])
+            w.failed = 1; // would overlap the next range: never publish it
+        r->lengths[row] = length;
+    }
+
+    r->bytes = w.offset;
+    if (w.failed)
+        r->failed = 1;
+    if (reportWriterClose(&w) != 0)
+        r->failed = 1;
+    return NULL;
+}
+
+int exportCBText(const char *columnFile, const char *outputFile, const char *indexFile)
+{
+    static const char header[] = "#Customers Data Base:\n";
+
+    // Any previous index describes the old report
+    if (indexFile)
+        remove(indexFile);
+
+    CBColumns cols;
+    if (openCBColumns(&cols, columnFile) != 0) return -1;
+
+    // Write to a temporary name so concurrent readers never see a partial report
+    static unsigned long tmpCounter = 0;
+    char tmpPath[560];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.%d.%lu.tmp", outputFile, (int)getpid(),
+             __sync_fetch_and_add(&tmpCounter, 1));
+
+    uint32_t *lengths = (uint32_t *)malloc((cols.rows ? cols.rows : 1) * sizeof(uint32_t));
+    int fd = lengths ? open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+    if (fd < 0) {
+        fprintf(stderr, "Error creating output file '%s': %s\n", tmpPath, strerror(errno));
+        free(lengths);
+        closeCBColumns(&cols);
+        return -1;
+    }
+    int failed = pwrite(fd, header, sizeof(header) - 1, 0) != (ssize_t)(sizeof(header) - 1);
+
+    // Split the rows into contiguous ranges, one per worker
+    uint64_t workers = (uint64_t)cdrWorkerCount();
+    if (workers > cols.rows / CB_EXPORT_MIN_ROWS + 1)
+        workers = cols.rows / CB_EXPORT_MIN_ROWS + 1;
+
+    ExportRange ranges[CDR_MAX_WORKERS];
+    int count = (int)workers;
+    uint64_t overhead = count > 1 ? recordOverhead() : 0;
+    for (int i = 0; i < count; i++) {
+        ranges[i].cols = &cols;
+        ranges[i].first = cols.rows * (uint64_t)i / workers;
+        ranges[i].last = cols.rows * (uint64_t)(i + 1) / workers;
+        ranges[i].fd = count > 1 ? -1 : fd;
+        ranges[i].base = sizeof(header) - 1;
+        ranges[i].bytes = 0;
+        ranges[i].overhead = overhead;
+        ranges[i].lengths = lengths;
+        ranges[i].measured = 0;
+        ranges[i].failed = 0;
+    }
+
+    if (count > 1) {
+        // Work out each record's length from the column values (no
+        // formatting), then let every worker format its range once and
+        // pwrite it at the offset where the preceding ranges end. Memory
+        // stays at one writer buffer per worker, whatever the report size.
+        runWorkers(exportRangeThread, ranges, sizeof(ExportRange), count);
+        for (int i = 0; i < count; i++) {
+            if (i > 0)
+                ranges[i].base = ranges[i - 1].base + ranges[i - 1].bytes;
+            ranges[i].fd = fd;
+            ranges[i].measured = 1;
+        }
+    }
+    runWorkers(exportRangeThread, ranges, sizeof(ExportRange), count);
+    uint64_t written = ranges[count - 1].base + ranges[count - 1].bytes;
+
+    for (int i = 0; i < count; i++)
+        failed |= ranges[i].failed;
+    if (close(fd) != 0)
+        failed = 1;
+
+    // A newer run may have replaced CB.col meanwhile: never publish text
+    // generated from the old one
+    if (!colFileIsCurrent(&cols.file, columnFile)) {
+        remove(tmpPath);
+        free(lengths);
+        closeCBColumns(&cols);
+        return -1;
+    }
+
+    if (failed || rename(tmpPath, outputFile) != 0) {
+        fprintf(stderr, "Error writing output file '%s': %s\n", outputFile, strerror(errno));
+        remove(tmpPath);
+        free(lengths);
+        closeCBColumns(&cols);
+        return -1;
+    }
+
+    // Index table sized like the customer table that produced the rows
+    size_t capacity = CUST_TABLE_MIN_CAPACITY;
+    while (cols.rows * 100 > capacity * CUST_TABLE_MAX_LOAD)
+        capacity *= 2;
+    CBIndexEntry *entries = indexFile ? (CBIndexEntry *)malloc(capacity * sizeof(CBIndexEntry)) : NULL;
+    if (entries) {
+        for (size_t i = 0; i < capacity; i++) {
+            entries[i].msisdn = CUST_EMPTY_KEY;
+            entries[i].offset = 0;
+            entries[i].length = 0;
+            entries[i].reserved = 0;
+        }
+
+        uint64_t offset = sizeof(header) - 1;
+        for (uint64_t r = 0; r < cols.rows; r++) {
+            long msisdn = (long)cols.msisdn[r];
+            if (msisdn != CUST_EMPTY_KEY) {
+                // Same probe sequence as CustomerTable; offsets skip the
+                // blank line that opens each record
+                size_t mask = capacity - 1;
+                size_t i = hashFunction(msisdn) & mask;
+                while (entries[i].msisdn != CUST_EMPTY_KEY && entries[i].msisdn != msisdn)
+                    i = (i + 1) & mask;
+                entries[i].msisdn = msisdn;
+                entries[i].offset = offset + 1;
+                entries[i].length = lengths[r] - 1;
+            }
+            offset += lengths[r];
+        }
+        writeCBIndex(indexFile, entries, capacity, (size_t)cols.rows, written);
+    }
+
+    free(entries);
+    free(lengths);
+    closeCBColumns(&cols);
+    return 0;
+}
+
+/* ============================================================
+   Memory Management
+   ============================================================ */
+
+void freeCustomerTable(CustomerTable *table)
+{
+    free(table->keys);
+    free(table->slots);
+    arenaRelease(&table->arena);
+    table->keys = NULL;
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+    table->totalRecords = 0;
 }
 
 /* ============================================================
@@ -218,26 +1006,23 @@ void cleanupHashTable(void)
 
 void* custbillprocess(void *arg)
 {
-    ProcessThreadArg *threadArg = (ProcessThreadArg *)arg;
-    
-    // Build file paths
-    const char *inputPath = "data/data.cdr";
-    char outputPath[300];
-    snprintf(outputPath, sizeof(outputPath), "%s/CB.txt", 
-             threadArg ? threadArg->output_dir : "Output");
+    BillingJob *job = (BillingJob *)arg;
     
-    // Initialize hash table to NULL
-    for (int i = 0; i < HASH_SIZE; i++)
-        hashTable[i] = NULL;
+    // Build output paths
+    char columnPath[300];
+    char textPath[300];
+    char indexPath[300];
+    snprintf(columnPath, sizeof(columnPath), "%s/%s", job->output_dir, CB_COLUMN_FILE);
+    snprintf(textPath, sizeof(textPath), "%s/CB.txt", job->output_dir);
+    snprintf(indexPath, sizeof(indexPath), "%s/%s", job->output_dir, CB_INDEX_FILE);
     
-    // Process CDR file and aggregate customer data
-    processCDRFile(inputPath);
-    
-    // Write customer billing report
-    writeCBFile(outputPath);
-    
-    // Free allocated memory
-    cleanupHashTable();
+    // Write the columnar results; the text report from an earlier run is
+    // stale now and is regenerated from CB.col when requested
+    if (writeCBColumns(&job->customers, columnPath) == 0) {
+        job->customerSaved = 1;
+        remove(textPath);
+        remove(indexPath);
+    }
     
     return NULL;
 }
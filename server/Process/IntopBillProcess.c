@@ -1,219 +1,459 @@
 // IntopBillProcess.c - Interoperator billing CDR processing
+// Aggregation state lives in the OperatorTable passed in by the caller
+// (normally the BillingJob of one processing run).
 #include "../Header/IntopBillProcess.h"
-#include "../Header/CustBillProcess.h" // for ProcessThreadArg
-
-/* ============================================================
-   Static Variables
-   ============================================================ */
-
-static OpNode *buckets[NUM_BUCKETS] = {NULL};
+#include <fcntl.h>
+#include <unistd.h>
+#include "../Header/process.h" // for BillingJob
 
 /* ============================================================
    Hash Map Implementation
    ============================================================ */
 
-unsigned long str_hash(const char *s)
+// djb2 hash over a pointer+length view
+static unsigned long str_hash_n(const char *s, size_t len)
 {
     unsigned long hash = 5381;
-    int c;
-    while ((c = (unsigned char)*s++))
-        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+    for (size_t i = 0; i < len; i++)
+        hash = ((hash << 5) + hash) + (unsigned char)s[i]; /* hash * 33 + c */
     return hash;
 }
 
-OpNode *get_or_create_opnode(const char *operator_id, const char *operator_name)
+// Lookup by field view; key and name are only copied when a node is created
+static OpNode *get_or_create_opnode_n(OperatorTable *table,
+                                      const char *operator_id, size_t id_len,
+                                      const char *operator_name, size_t name_len)
 {
-    unsigned long h = str_hash(operator_id);
+    unsigned long h = str_hash_n(operator_id, id_len);
     unsigned idx = (unsigned)(h % NUM_BUCKETS);
-    OpNode *node = buckets[idx];
+    OpNode *node = table->buckets[idx];
 
     while (node)
     {
-        if (strcmp(node->operator_id, operator_id) == 0)
+        if (strncmp(node->operator_id, operator_id, id_len) == 0 &&
+            node->operator_id[id_len] == '\0')
             return node;
         node = node->next;
     }
 
-    // Create a new node
-    OpNode *newnode = (OpNode *)calloc(1, sizeof(OpNode));
-    newnode->operator_id = strdup(operator_id);
-    newnode->stats.operator_name = operator_name ? strdup(operator_name) : strdup("UNKNOWN");
-    newnode->next = buckets[idx];
-    buckets[idx] = newnode;
+    // Create a new node; node and strings come from the table's arena
+    OpNode *newnode = (OpNode *)arenaAlloc(&table->arena, sizeof(OpNode));
+    if (!newnode) return NULL;
+    newnode->operator_id = arenaStrndup(&table->arena, operator_id, id_len);
+    newnode->stats.operator_name = operator_name
+        ? (char *)arenaIntern(&table->arena, operator_name, name_len)
+        : (char *)arenaIntern(&table->arena, "UNKNOWN", 7);
+    if (!newnode->operator_id || !newnode->stats.operator_name) return NULL;
+    newnode->next = table->buckets[idx];
+    table->buckets[idx] = newnode;
     return newnode;
 }
 
-/* ============================================================
-   Utility Functions
-   ============================================================ */
-
-void chomp(char *s)
+OpNode *get_or_create_opnode(OperatorTable *table, const char *operator_id,
+                             const char *operator_name)
 {
-    if (!s) return;
-    
-    size_t n = strlen(s);
-    while (n > 0 && (s[n - 1] == '\n' || s[n - 1] == '\r'))
-        s[--n] = '\0';
-}
-
-int split_pipe(char *line, char **tokens, int max_tokens)
-{
-    int idx = 0;
-    char *start = line;
-    for (char *p = line; *p && idx < max_tokens - 1; p++)
-    {
-        if (*p == '|')
-        {
-            *p = '\0';
-            tokens[idx++] = start;
-            start = p + 1;
-        }
-    }
-    tokens[idx++] = start;
-    return idx;
-}
-
-long to_long_or_zero(const char *s)
-{
-    if (!s || *s == '\0') return 0;
-    
-    char *endptr;
-    long v = strtol(s, &endptr, 10);
-    
-    return (endptr == s) ? 0 : v;
+    return get_or_create_opnode_n(table, operator_id, strlen(operator_id), operator_name,
+                                  operator_name ? strlen(operator_name) : 0);
 }
 
 /* ============================================================
    CDR Line Processor
    ============================================================ */
 
-void process_line(char *line)
+void operatorConsumeRecord(const CDRRecord *rec, void *ctx)
 {
-    chomp(line);
-    if (line[0] == '\0') return;
+    OperatorTable *table = (OperatorTable *)ctx;
 
-    // Parse CDR line into tokens
-    char *tokens[12];
-    int n = split_pipe(line, tokens, 9);
-    
-    // Fill missing tokens with empty strings
-    for (int i = n; i < 9; ++i)
-        tokens[i] = "";
+    // Skip lines whose numeric fields did not parse, as CB does
+    if (!rec->typedValid) return;
 
     // Extract fields
-    const char *operator_name = tokens[1];
-    const char *operator_id = tokens[2];
-    const char *call_type = tokens[3];
-    const char *duration_s = tokens[4];
-    const char *download_s = tokens[5];
-    const char *upload_s = tokens[6];
+    CDRField operator_name = rec->fields[1];
+    CDRField operator_id = rec->fields[2];
 
     // Validate operator_id
-    if (!operator_id || operator_id[0] == '\0') return;
-    if (!call_type) return;
+    if (operator_id.len == 0) return;
 
     // Get or create operator node
-    OpNode *node = get_or_create_opnode(operator_id, operator_name);
+    OpNode *node = get_or_create_opnode_n(table, operator_id.ptr, operator_id.len,
+                                          operator_name.ptr, operator_name.len);
+    if (!node) return;
     OperatorStats *stats = &node->stats;
 
-    // Normalize call type to uppercase
-    char call_type_upper[32];
-    snprintf(call_type_upper, sizeof(call_type_upper), "%s", call_type);
-    for (char *p = call_type_upper; *p; ++p)
-        *p = toupper((unsigned char)*p);
-
-    // Update statistics based on call type
-    if (strcmp(call_type_upper, "MOC") == 0)
-        stats->total_moc_duration += to_long_or_zero(duration_s);
-    else if (strcmp(call_type_upper, "MTC") == 0)
-        stats->total_mtc_duration += to_long_or_zero(duration_s);
-    else if (strcmp(call_type_upper, "SMS-MO") == 0)
+    // Update statistics based on the decoded call type (any letter case).
+    // Volumes are summed exactly in fixed-point units.
+    switch (rec->callType) {
+    case CDR_CALL_MOC:
+        stats->total_moc_duration += rec->duration;
+        break;
+    case CDR_CALL_MTC:
+        stats->total_mtc_duration += rec->duration;
+        break;
+    case CDR_CALL_SMS_MO:
         stats->sms_mo_count++;
-    else if (strcmp(call_type_upper, "SMS-MT") == 0)
+        break;
+    case CDR_CALL_SMS_MT:
         stats->sms_mt_count++;
-    else if (strcmp(call_type_upper, "GPRS") == 0) {
-        stats->total_download += to_long_or_zero(download_s);
-        stats->total_upload += to_long_or_zero(upload_s);
+        break;
+    case CDR_CALL_GPRS:
+        stats->total_download += rec->download;
+        stats->total_upload += rec->upload;
+        break;
+    default:
+        break;
     }
 }
 
 /* ============================================================
-   Helper Functions for Main Processing
+   Partial Table Merge
    ============================================================ */
 
-static void write_billing_output(FILE *fout)
+void merge_operator_table(OperatorTable *dst, OperatorTable *src)
 {
     for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
-        OpNode *node = buckets[i];
-        while (node) {
-            OperatorStats *stats = &node->stats;
-            fprintf(fout, "Operator Brand: %s (%s)\n", stats->operator_name, node->operator_id);
-            fprintf(fout, "\tIncoming voice call durations: %ld\n", stats->total_mtc_duration);
-            fprintf(fout, "\tOutgoing voice call durations: %ld\n", stats->total_moc_duration);
-            fprintf(fout, "\tIncoming SMS messages: %ld\n", stats->sms_mt_count);
-            fprintf(fout, "\tOutgoing SMS messages: %ld\n", stats->sms_mo_count);
-            fprintf(fout, "\tMB Download: %ld | MB Uploaded: %ld\n", 
-                    stats->total_download, stats->total_upload);
-            fprintf(fout, "----------------------------------------\n");
-            node = node->next;
+        // Reverse the newest-first chain so nodes merge in first-seen order
+        OpNode *rev = NULL;
+        while (src->buckets[i]) {
+            OpNode *n = src->buckets[i];
+            src->buckets[i] = n->next;
+            n->next = rev;
+            rev = n;
+        }
+
+        while (rev) {
+            OpNode *n = rev;
+            rev = rev->next;
+
+            OpNode *found = dst->buckets[i];
+            while (found && strcmp(found->operator_id, n->operator_id) != 0)
+                found = found->next;
+
+            if (found) {
+                // Existing operator keeps its first-seen name
+                found->stats.total_moc_duration += n->stats.total_moc_duration;
+                found->stats.total_mtc_duration += n->stats.total_mtc_duration;
+                found->stats.sms_mo_count += n->stats.sms_mo_count;
+                found->stats.sms_mt_count += n->stats.sms_mt_count;
+                found->stats.total_download += n->stats.total_download;
+                found->stats.total_upload += n->stats.total_upload;
+            } else {
+                n->next = dst->buckets[i];
+                dst->buckets[i] = n;
+            }
         }
     }
+
+    // Moved nodes still live in src's blocks: hand them over to dst
+    arenaAdopt(&dst->arena, &src->arena);
 }
 
-static void cleanup_hash_table(void)
+int copy_operator_table(OperatorTable *dst, const OperatorTable *src)
 {
+    free_operator_table(dst);
+
     for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
-        OpNode *node = buckets[i];
-        while (node) {
-            OpNode *tmp = node->next;
-            free(node->operator_id);
-            free(node->stats.operator_name);
-            free(node);
-            node = tmp;
+        // Keep each chain's order so the copy lists operators like the source
+        OpNode **tail = &dst->buckets[i];
+        for (const OpNode *n = src->buckets[i]; n; n = n->next) {
+            OpNode *copy = (OpNode *)arenaAlloc(&dst->arena, sizeof(OpNode));
+            if (!copy) {
+                free_operator_table(dst);
+                return -1;
+            }
+            copy->operator_id = arenaStrndup(&dst->arena, n->operator_id, strlen(n->operator_id));
+            copy->stats = n->stats;
+            copy->stats.operator_name = (char *)arenaIntern(&dst->arena, n->stats.operator_name,
+                                                            strlen(n->stats.operator_name));
+            copy->next = NULL;
+            if (!copy->operator_id || !copy->stats.operator_name) {
+                free_operator_table(dst);
+                return -1;
+            }
+            *tail = copy;
+            tail = &copy->next;
+        }
+    }
+    return 0;
+}
+
+/* ============================================================
+   Helper Functions for Main Processing
+   ============================================================ */
+
+void emit_operator_record(ReportWriter *w, const OpNode *node)
+{
+    const OperatorStats *stats = &node->stats;
+
+    // The report shows whole units, rounded from the exact totals
+    reportPutLit(w, "Operator Brand: ");
+    reportPutStr(w, stats->operator_name);
+    reportPutLit(w, " (");
+    reportPutStr(w, node->operator_id);
+    reportPutLit(w, ")\n\tIncoming voice call durations: ");
+    reportPutFixed(w, stats->total_mtc_duration, 0);
+    reportPutLit(w, "\n\tOutgoing voice call durations: ");
+    reportPutFixed(w, stats->total_moc_duration, 0);
+    reportPutLit(w, "\n\tIncoming SMS messages: ");
+    reportPutLong(w, stats->sms_mt_count);
+    reportPutLit(w, "\n\tOutgoing SMS messages: ");
+    reportPutLong(w, stats->sms_mo_count);
+    reportPutLit(w, "\n\tMB Download: ");
+    reportPutFixed(w, stats->total_download, 0);
+    reportPutLit(w, " | MB Uploaded: ");
+    reportPutFixed(w, stats->total_upload, 0);
+    reportPutLit(w, "\n----------------------------------------\n");
+}
+
+int format_operator_record(char *buf, size_t size, const OpNode *node)
+{
+    ReportWriter w;
+    reportWriterInitBuffer(&w, buf, size);
+    emit_operator_record(&w, node);
+    reportWriterFinishBuffer(&w);
+    return (int)w.offset;
+}
+
+// Operator ids are numeric codes: order all-digit ids by value, anything
+// else bytewise
+static int compare_operator_id(const void *a, const void *b)
+{
+    const char *x = (*(const OpNode *const *)a)->operator_id;
+    const char *y = (*(const OpNode *const *)b)->operator_id;
+    size_t xl = strlen(x), yl = strlen(y);
+    int numeric = xl == strspn(x, "0123456789") && yl == strspn(y, "0123456789");
+    if (numeric) {
+        while (xl > 1 && *x == '0') { x++; xl--; }
+        while (yl > 1 && *y == '0') { y++; yl--; }
+        if (xl != yl) return xl < yl ? -1 : 1;
+    }
+    int c = strcmp(x, y);
+    return c ? c : strcmp((*(const OpNode *const *)a)->operator_id,
+                          (*(const OpNode *const *)b)->operator_id);
+}
+
+const OpNode** list_operators(const OperatorTable *table, size_t *count)
+{
+    size_t rows = 0;
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+        for (const OpNode *node = table->buckets[i]; node; node = node->next)
+            rows++;
+
+    const OpNode **nodes = (const OpNode **)malloc((rows ? rows : 1) * sizeof(*nodes));
+    if (!nodes) return NULL;
+
+    size_t r = 0;
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+        for (const OpNode *node = table->buckets[i]; node; node = node->next)
+            nodes[r++] = node;
+
+    if (colSortedOutput())
+        qsort(nodes, rows, sizeof(*nodes), compare_operator_id);
+    *count = rows;
+    return nodes;
+}
+
+void free_operator_table(OperatorTable *table)
+{
+    // Every node and string is in the arena: release it in one go
+    arenaRelease(&table->arena);
+    memset(table->buckets, 0, sizeof(table->buckets));
+}
+
+/* ============================================================
+   Columnar Output
+   ============================================================ */
+
+// Counter columns of IOSB.col, in report order
+static const char *const iosb_metric_names[IOSB_METRIC_COUNT] = {
+    "mtc_duration", "moc_duration", "sms_mt", "sms_mo", "download", "upload"
+};
+
+static int64_t iosb_metric(const OperatorStats *stats, int m)
+{
+    switch (m) {
+    case 0: return stats->total_mtc_duration;
+    case 1: return stats->total_moc_duration;
+    case 2: return stats->sms_mt_count;
+    case 3: return stats->sms_mo_count;
+    case 4: return stats->total_download;
+    default: return stats->total_upload;
+    }
+}
+
+static void set_iosb_metric(OperatorStats *stats, int m, int64_t value)
+{
+    switch (m) {
+    case 0: stats->total_mtc_duration = value; break;
+    case 1: stats->total_moc_duration = value; break;
+    case 2: stats->sms_mt_count = (long)value; break;
+    case 3: stats->sms_mo_count = (long)value; break;
+    case 4: stats->total_download = value; break;
+    default: stats->total_upload = value; break;
+    }
+}
+
+int write_iosb_columns(const OperatorTable *table, const char *column_path)
+{
+    // Rows are in report order, which is also the order of IOSB.txt
+    size_t rows = 0;
+    const OpNode **nodes = list_operators(table, &rows);
+    const char **ids = (const char **)malloc((rows ? rows : 1) * sizeof(*ids));
+    const char **names = (const char **)malloc((rows ? rows : 1) * sizeof(*names));
+    if (!nodes || !ids || !names) {
+        free(nodes);
+        free(ids);
+        free(names);
+        return -1;
+    }
+
+    size_t r;
+    for (r = 0; r < rows; r++) {
+        ids[r] = nodes[r]->operator_id;
+        names[r] = nodes[r]->stats.operator_name;
+    }
+
+    ColFileWriter w;
+    int rc = colWriterOpen(&w, column_path, IOSB_COLUMN_KIND, rows,
+                           2 + IOSB_METRIC_COUNT, CDR_FIXED_SCALE);
+    if (rc == 0) {
+        colWriterStrings(&w, "operator_id", ids, rows);
+        colWriterStrings(&w, "operator_name", names, rows);
+
+        for (int m = 0; m < IOSB_METRIC_COUNT; m++) {
+            colWriterBegin(&w, iosb_metric_names[m], COL_INT64, rows);
+            for (r = 0; r < rows; r++) {
+                int64_t v = iosb_metric(&nodes[r]->stats, m);
+                colWriterPut(&w, &v, sizeof(v));
+            }
+            colWriterEnd(&w);
         }
-        buckets[i] = NULL;
+        rc = colWriterClose(&w);
     }
+
+    free(nodes);
+    free(ids);
+    free(names);
+    return rc;
 }
 
 /* ============================================================
-   Main Processing Function
+   Columnar Input
    ============================================================ */
 
-void InteroperatorBillingProcess(const char *input_path, const char *output_path)
+int open_iosb_columns(IOSBColumns *cols, const char *column_path)
 {
-    // Open input file
-    FILE *fin = fopen(input_path, "r");
-    if (!fin) {
-        fprintf(stderr, "Error opening input file '%s': %s\n", input_path, strerror(errno));
-        return;
+    memset(cols, 0, sizeof(*cols));
+    if (colFileOpen(&cols->file, column_path, IOSB_COLUMN_KIND) != 0)
+        return -1;
+
+    const ColFile *f = &cols->file;
+    uint64_t rows = f->header->rowCount;
+
+    cols->rows = rows;
+    cols->operator_id = colFileColumn(f, "operator_id", COL_STRING, rows);
+    cols->operator_name = colFileColumn(f, "operator_name", COL_STRING, rows);
+
+    int ok = cols->operator_id && cols->operator_name;
+    for (int m = 0; m < IOSB_METRIC_COUNT && ok; m++) {
+        cols->metrics[m] = (const int64_t *)colFileColumn(f, iosb_metric_names[m], COL_INT64, rows);
+        ok = cols->metrics[m] != NULL;
     }
 
-    // Open output file
-    FILE *fout = fopen(output_path, "w");
-    if (!fout) {
-        fprintf(stderr, "Error creating output file '%s': %s\n", output_path, strerror(errno));
-        fclose(fin);
-        return;
+    if (!ok) {
+        close_iosb_columns(cols);
+        return -1;
     }
+    return 0;
+}
 
-    // Process CDR file line by line
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t read;
+void close_iosb_columns(IOSBColumns *cols)
+{
+    colFileClose(&cols->file);
+    memset(cols, 0, sizeof(*cols));
+}
 
-    while ((read = getline(&line, &len, fin)) != -1) {
-        process_line(line);
+void load_iosb_column_row(const IOSBColumns *cols, uint64_t row, OpNode *node)
+{
+    memset(node, 0, sizeof(*node));
+    node->operator_id = (char *)colFileString(cols->operator_id, cols->rows, row);
+    node->stats.operator_name = (char *)colFileString(cols->operator_name, cols->rows, row);
+    for (int m = 0; m < IOSB_METRIC_COUNT; m++)
+        set_iosb_metric(&node->stats, m, cols->metrics[m][row]);
+}
+
+int load_iosb_columns_into(OperatorTable *table, const char *column_path)
+{
+    IOSBColumns cols;
+    if (open_iosb_columns(&cols, column_path) != 0) return -1;
+
+    int failed = 0;
+    for (uint64_t r = 0; r < cols.rows && !failed; r++) {
+        OpNode saved;
+        load_iosb_column_row(&cols, r, &saved);
+        OpNode *node = get_or_create_opnode(table, saved.operator_id, saved.stats.operator_name);
+        if (!node) {
+            failed = 1;
+            break;
+        }
+        for (int m = 0; m < IOSB_METRIC_COUNT; m++)
+            set_iosb_metric(&node->stats, m, iosb_metric(&node->stats, m) +
+                                             iosb_metric(&saved.stats, m));
     }
 
-    free(line);
-    fclose(fin);
+    close_iosb_columns(&cols);
+    return failed ? -1 : 0;
+}
+
+/* ============================================================
+   Text Export
+   ============================================================ */
 
-    // Write aggregated results to output file
-    write_billing_output(fout);
-    fclose(fout);
+int export_iosb_text(const char *column_path, const char *output_path)
+{
+    IOSBColumns cols;
+    if (open_iosb_columns(&cols, column_path) != 0) return -1;
+
+    // Write to a temporary name so concurrent readers never see a partial report
+    static unsigned long tmp_counter = 0;
+    char tmp_path[560];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.%lu.tmp", output_path, (int)getpid(),
+             __sync_fetch_and_add(&tmp_counter, 1));
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ReportWriter w;
+    if (fd < 0 || reportWriterOpen(&w, fd) != 0) {
+        fprintf(stderr, "Error creating output file '%s': %s\n", tmp_path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            remove(tmp_path);
+        }
+        close_iosb_columns(&cols);
+        return -1;
+    }
 
-    // Cleanup allocated memory
-    cleanup_hash_table();
+    for (uint64_t r = 0; r < cols.rows && !w.failed; r++) {
+        OpNode node;
+        load_iosb_column_row(&cols, r, &node);
+        emit_operator_record(&w, &node);
+    }
+    int rc = reportWriterClose(&w);
+    if (close(fd) != 0)
+        rc = -1;
+
+    // Never publish text generated from an IOSB.col that a newer run replaced
+    if (!colFileIsCurrent(&cols.file, column_path)) {
+        close_iosb_columns(&cols);
+        remove(tmp_path);
+        return -1;
+    }
+    close_iosb_columns(&cols);
+
+    if (rc != 0 || rename(tmp_path, output_path) != 0) {
+        fprintf(stderr, "Error writing output file '%s': %s\n", output_path, strerror(errno));
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
 }
 
 /* ============================================================
@@ -222,16 +462,20 @@ void InteroperatorBillingProcess(const char *input_path, const char *output_path
 
 void* intopbillprocess(void *arg)
 {
-    ProcessThreadArg *threadArg = (ProcessThreadArg *)arg;
+    BillingJob *job = (BillingJob *)arg;
     
-    // Build file paths
-    const char *input_file = "data/data.cdr";
+    // Build output paths
+    char column_file[512];
     char output_file[512];
-    snprintf(output_file, sizeof(output_file), "%s/IOSB.txt",
-             threadArg ? threadArg->output_dir : "Output");
+    snprintf(column_file, sizeof(column_file), "%s/%s", job->output_dir, IOSB_COLUMN_FILE);
+    snprintf(output_file, sizeof(output_file), "%s/IOSB.txt", job->output_dir);
     
-    // Process CDR and generate interoperator billing
-    InteroperatorBillingProcess(input_file, output_file);
+    // Write the columnar results; the text report from an earlier run is
+    // stale now and is regenerated from IOSB.col when requested
+    if (write_iosb_columns(&job->operators, column_file) == 0) {
+        job->operatorSaved = 1;
+        remove(output_file);
+    }
     
     return NULL;
 }
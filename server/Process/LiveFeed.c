@@ -0,0 +1,416 @@
+// LiveFeed.c - Follow mode: continuously aggregated CDR input
+// One background thread keeps customer and operator aggregates of the whole
+// input file up to date by scanning only the bytes appended since its last
+// scan. Processing requests copy these aggregates instead of rescanning the
+// file, and registered output directories are rewritten on a timer.
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include "../Header/LiveFeed.h"
+#include "../Header/Log.h"
+
+/* ============================================================
+   Feed State
+   ============================================================ */
+
+static pthread_mutex_t feedLock = PTHREAD_MUTEX_INITIALIZER; // current state and directories
+static pthread_mutex_t scanLock = PTHREAD_MUTEX_INITIALIZER; // one catch-up scan at a time
+
+// Published aggregates. Readers take a reference under feedLock and copy
+// the tables after releasing it; the tables of a referenced state are never
+// modified, so catchUp builds the next state beside it and swaps it in.
+typedef struct {
+    BillingJob *job;              // aggregates of input bytes [0, job->input.end)
+    int refs;                     // the feed's own + readers copying it (feedLock)
+} LiveState;
+
+static LiveState *live = NULL;    // current state, replaced only by catchUp
+static uint64_t generation = 0;   // bumped whenever the aggregates change
+static char inputPath[256];
+static int running = 0;           // accessed with __atomic loads and stores
+static pthread_t feedThread;
+static int wakePipe[2] = { -1, -1 };
+
+typedef struct {
+    char output_dir[256];
+    uint64_t generation;          // state the directory was last written from
+} LiveDir;
+
+static LiveDir dirs[LIVE_MAX_DIRS];
+static int dirCount = 0;
+
+static int feedRunning(void)
+{
+    return __atomic_load_n(&running, __ATOMIC_ACQUIRE);
+}
+
+static LiveState* newLiveState(BillingJob *job)
+{
+    LiveState *st = job ? (LiveState *)calloc(1, sizeof(LiveState)) : NULL;
+    if (!st) return NULL;
+    st->job = job;
+    st->refs = 1;
+    return st;
+}
+
+static void releaseLiveState(LiveState *st)
+{
+    pthread_mutex_lock(&feedLock);
+    int last = --st->refs == 0;
+    pthread_mutex_unlock(&feedLock);
+    if (last) {
+        destroyBillingJob(st->job);
+        free(st);
+    }
+}
+
+// Make st the current state; the previous one goes once its readers are done
+static void publishLiveState(LiveState *st)
+{
+    pthread_mutex_lock(&feedLock);
+    LiveState *old = live;
+    live = st;
+    generation++;
+    pthread_mutex_unlock(&feedLock);
+    releaseLiveState(old);
+}
+
+static int refreshInterval(void)
+{
+    const char *env = getenv(LIVE_REFRESH_ENV);
+    if (!env || !*env) return LIVE_REFRESH_DEFAULT;
+    int secs = atoi(env);
+    return secs > 0 ? secs : 0;
+}
+
+/* ============================================================
+   Catch-Up Scan
+   ============================================================ */
+
+// Aggregate whatever was appended to the input since the last scan, or all
+// of it if the file was replaced or truncated. Returns 0 if the aggregates
+// are current, -1 if the input cannot be read.
+static int catchUp(void)
+{
+    pthread_mutex_lock(&scanLock);
+
+    struct stat st;
+    if (stat(inputPath, &st) != 0 || !S_ISREG(st.st_mode)) {
+        pthread_mutex_unlock(&scanLock);
+        return -1;
+    }
+
+    // Only this function modifies `live`, and scanLock is held
+    BillingJob *cur = live->job;
+    uint64_t start = cur->input.end;
+    if ((uint64_t)st.st_dev != cur->input.dev || (uint64_t)st.st_ino != cur->input.ino ||
+        (uint64_t)st.st_size < start)
+        start = 0;                                  // new file: start over
+    else if ((uint64_t)st.st_size == start) {
+        pthread_mutex_unlock(&scanLock);
+        return 0;                                   // nothing appended
+    }
+
+    BillingJob *delta = createBillingJob("");
+    long scanned = delta ? scanAndMerge(delta, inputPath, start, CDR_SCAN_WHOLE_LINES,
+                                        cdrWorkerCount())
+                         : -1;
+
+    // The file may have been replaced between stat() and the scan: try again
+    // on the next wakeup
+    if (scanned < 0 || delta->input.dev != (uint64_t)st.st_dev ||
+        delta->input.ino != (uint64_t)st.st_ino) {
+        destroyBillingJob(delta);
+        pthread_mutex_unlock(&scanLock);
+        return scanned < 0 ? -1 : 0;
+    }
+
+    if (start == 0) {
+        // The scan covers the whole file: it becomes the new state
+        if (cur->input.ino != 0)
+            LOG_INFO("Follow mode: %s was replaced or truncated, rescanned", inputPath);
+        delta->records = scanned;
+        LiveState *fresh = newLiveState(delta);
+        if (!fresh) {
+            destroyBillingJob(delta);
+            pthread_mutex_unlock(&scanLock);
+            return -1;
+        }
+        publishLiveState(fresh);
+        pthread_mutex_unlock(&scanLock);
+        return 0;
+    }
+
+    pthread_mutex_lock(&feedLock);
+    if (live->refs == 1 || scanned == 0) {
+        // Nobody is copying the tables: merge in place (costs as much as
+        // the appended records). Existing entries keep their first-seen names.
+        if (scanned > 0) {
+            mergeCustomerTable(&cur->customers, &delta->customers);
+            merge_operator_table(&cur->operators, &delta->operators);
+            cur->records += scanned;
+            cur->malformed += delta->malformed;
+            generation++;
+        }
+        cur->input.end = delta->input.end;          // after the last complete line
+        pthread_mutex_unlock(&feedLock);
+        destroyBillingJob(delta);
+        pthread_mutex_unlock(&scanLock);
+        return 0;
+    }
+    pthread_mutex_unlock(&feedLock);
+
+    // A reader is copying the current tables: merge into a copy instead
+    BillingJob *next = createBillingJob("");
+    LiveState *fresh = NULL;
+    if (next && copyCustomerTable(&next->customers, &cur->customers) == 0 &&
+        copy_operator_table(&next->operators, &cur->operators) == 0) {
+        mergeCustomerTable(&next->customers, &delta->customers);
+        merge_operator_table(&next->operators, &delta->operators);
+        next->records = cur->records + scanned;
+        next->malformed = cur->malformed + delta->malformed;
+        next->input = cur->input;
+        next->input.end = delta->input.end;
+        fresh = newLiveState(next);
+    }
+    destroyBillingJob(delta);
+    if (!fresh) {
+        destroyBillingJob(next);
+        pthread_mutex_unlock(&scanLock);
+        return -1;
+    }
+    publishLiveState(fresh);
+    pthread_mutex_unlock(&scanLock);
+    return 0;
+}
+
+/* ============================================================
+   Copy and Refresh
+   ============================================================ */
+
+int liveFeedCopy(BillingJob *job, uint64_t *gen)
+{
+    if (!feedRunning()) return -1;
+    catchUp();
+
+    // Take the current state and its counters; the tables are copied after
+    // the lock is released, so the follower is never held up by a copy
+    pthread_mutex_lock(&feedLock);
+    LiveState *st = live;
+    st->refs++;
+    int rc = 0;
+    if (st->job->input.ino == 0) {
+        rc = -1;                                    // input never read
+    } else {
+        job->records = st->job->records;
+        job->malformed = st->job->malformed;
+        job->input = st->job->input;
+        snprintf(job->input_path, sizeof(job->input_path), "%s", inputPath);
+        if (gen) *gen = generation;
+    }
+    pthread_mutex_unlock(&feedLock);
+
+    if (rc == 0 && (copyCustomerTable(&job->customers, &st->job->customers) != 0 ||
+                    copy_operator_table(&job->operators, &st->job->operators) != 0))
+        rc = -1;
+    releaseLiveState(st);
+    return rc;
+}
+
+void liveFeedRegister(const char *output_dir, uint64_t gen)
+{
+    pthread_mutex_lock(&feedLock);
+    int i = 0;
+    while (i < dirCount && strcmp(dirs[i].output_dir, output_dir) != 0)
+        i++;
+    if (i == LIVE_MAX_DIRS) {
+        // Full: drop the directory registered first
+        memmove(&dirs[0], &dirs[1], sizeof(LiveDir) * (LIVE_MAX_DIRS - 1));
+        i = LIVE_MAX_DIRS - 1;
+    } else if (i == dirCount) {
+        dirCount++;
+    }
+    snprintf(dirs[i].output_dir, sizeof(dirs[i].output_dir), "%s", output_dir);
+    dirs[i].generation = gen;
+    pthread_mutex_unlock(&feedLock);
+}
+
+// Rewrite the results of every registered directory whose aggregates changed
+static void refreshDirs(void)
+{
+    for (int i = 0; ; i++) {
+        char output_dir[256];
+        pthread_mutex_lock(&feedLock);
+        int stale = i < dirCount && dirs[i].generation != generation;
+        if (i < dirCount)
+            memcpy(output_dir, dirs[i].output_dir, sizeof(output_dir));
+        int done = i >= dirCount;
+        pthread_mutex_unlock(&feedLock);
+        if (done) break;
+        if (!stale) continue;
+
+        BillingJob *job = createBillingJob(output_dir);
+        uint64_t gen = 0;
+        if (!job || liveFeedCopy(job, &gen) != 0) {
+            destroyBillingJob(job);
+            continue;
+        }
+        if (writeJobResults(job, -1)) {
+            liveFeedRegister(output_dir, gen);
+            LOG_INFO("Follow mode: refreshed results in %s", output_dir);
+        }
+    }
+}
+
+/* ============================================================
+   Follower Thread
+   ============================================================ */
+
+// Watch the input's directory, so a rotated or re-created file is noticed too
+static int watchInput(const char **name)
+{
+    char dir[256];
+    const char *slash = strrchr(inputPath, '/');
+    if (slash) {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - inputPath), inputPath);
+        *name = slash + 1;
+    } else {
+        snprintf(dir, sizeof(dir), ".");
+        *name = inputPath;
+    }
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) return -1;
+    if (inotify_add_watch(fd, dir, IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO |
+                                   IN_MOVED_FROM | IN_DELETE) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Drain pending events; 1 if any concerned the input file
+static int inputChanged(int fd, const char *name)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if ((ev->mask & IN_Q_OVERFLOW) || (ev->len && strcmp(ev->name, name) == 0))
+                changed = 1;
+            p += sizeof(*ev) + ev->len;
+        }
+    }
+    return changed;
+}
+
+static void* followThread(void *arg)
+{
+    (void)arg;
+    const char *name;
+    int inotifyFd = watchInput(&name);
+    if (inotifyFd < 0)
+        LOG_WARN("Follow mode: inotify unavailable (%s), checking %s every %d ms",
+                 strerror(errno), inputPath, LIVE_POLL_MS);
+
+    if (catchUp() != 0)
+        LOG_WARN("Follow mode: cannot read %s yet", inputPath);
+
+    int interval = refreshInterval();
+    time_t nextRefresh = time(NULL) + interval;
+
+    while (feedRunning()) {
+        int timeout = LIVE_POLL_MS;
+        if (interval > 0) {
+            time_t now = time(NULL);
+            int untilRefresh = now >= nextRefresh ? 0 : (int)(nextRefresh - now) * 1000;
+            if (untilRefresh < timeout) timeout = untilRefresh;
+        }
+
+        struct pollfd pfd[2] = {
+            { wakePipe[0], POLLIN, 0 },
+            { inotifyFd, POLLIN, 0 }
+        };
+        int n = poll(pfd, inotifyFd >= 0 ? 2 : 1, timeout);
+        if (n < 0 && errno != EINTR) break;
+        if (!feedRunning()) break;
+
+        // Scan on a change of the input, and on every timeout in case an
+        // event was missed
+        if (n == 0 || (n > 0 && (pfd[1].revents & POLLIN) && inputChanged(inotifyFd, name)))
+            catchUp();
+
+        if (interval > 0 && time(NULL) >= nextRefresh) {
+            refreshDirs();
+            nextRefresh = time(NULL) + interval;
+        }
+    }
+
+    if (inotifyFd >= 0) close(inotifyFd);
+    return NULL;
+}
+
+/* ============================================================
+   Start / Stop
+   ============================================================ */
+
+int liveFeedStart(const char *input_path)
+{
+    const char *env = getenv(LIVE_FEED_ENV);
+    if (!env || strcmp(env, "1") != 0) return 0;
+    if (feedRunning()) return 1;
+
+    // Only a single file can be followed
+    struct stat st;
+    if (strpbrk(input_path, "*?[") || cdrInputCompressed(input_path) ||
+        (stat(input_path, &st) == 0 && S_ISDIR(st.st_mode))) {
+        LOG_WARN("Follow mode: %s is not a single uncompressed file", input_path);
+        return -1;
+    }
+
+    BillingJob *empty = createBillingJob("");
+    live = newLiveState(empty);
+    if (!live || pipe(wakePipe) != 0) {
+        if (live) releaseLiveState(live);
+        else destroyBillingJob(empty);
+        live = NULL;
+        return -1;
+    }
+    snprintf(inputPath, sizeof(inputPath), "%s", input_path);
+
+    __atomic_store_n(&running, 1, __ATOMIC_RELEASE);
+    if (pthread_create(&feedThread, NULL, followThread, NULL) != 0) {
+        __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+        close(wakePipe[0]);
+        close(wakePipe[1]);
+        releaseLiveState(live);
+        live = NULL;
+        return -1;
+    }
+    LOG_INFO("Follow mode: aggregating %s as it grows", inputPath);
+    return 1;
+}
+
+int liveFeedActive(void)
+{
+    return feedRunning();
+}
+
+void liveFeedStop(void)
+{
+    if (!feedRunning()) return;
+    __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+    if (write(wakePipe[1], "x", 1) < 0)
+        LOG_WARN("Follow mode: cannot wake the follower: %s", strerror(errno));
+    pthread_join(feedThread, NULL);
+
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+    releaseLiveState(live);
+    live = NULL;
+}
@@ -0,0 +1,216 @@
+// ReportWriter.c - Buffered text emitter for the billing reports
+// Integers and fixed-point values are converted with a two-digits-per-step
+// table into one large buffer, which is written out with plain write() calls.
+#include <errno.h>
+#include <unistd.h>
+#include "../Header/ReportWriter.h"
+#include "../Header/CDRReader.h" // for CDR_FIXED_SCALE
+
+/* ============================================================
+   Setup and Flushing
+   ============================================================ */
+
+int reportWriterOpen(ReportWriter *w, int fd)
+{
+    memset(w, 0, sizeof(*w));
+    w->buf = (char *)malloc(REPORT_BUFFER_SIZE);
+    if (!w->buf) return -1;
+    w->fd = fd;
+    w->cap = REPORT_BUFFER_SIZE;
+    w->owned = 1;
+    w->filePos = -1;
+    return 0;
+}
+
+int reportWriterOpenAt(ReportWriter *w, int fd, uint64_t offset)
+{
+    if (reportWriterOpen(w, fd) != 0) return -1;
+    w->filePos = (int64_t)offset;
+    return 0;
+}
+
+void reportWriterInitBuffer(ReportWriter *w, char *buf, size_t size)
+{
+    memset(w, 0, sizeof(*w));
+    w->fd = -1;
+    w->filePos = -1;
+    w->buf = size ? buf : NULL;
+    w->cap = size ? size - 1 : 0; // keep room for the terminator
+}
+
+void reportWriterFinishBuffer(ReportWriter *w)
+{
+    if (w->buf)
+        w->buf[w->len] = '\0';
+}
+
+// Write n bytes to the file, at filePos when the writer is positioned
+static void writeOut(ReportWriter *w, const char *p, size_t n)
+{
+    size_t done = 0;
+    while (done < n && !w->failed) {
+        ssize_t r = w->filePos >= 0
+                        ? pwrite(w->fd, p + done, n - done, (off_t)w->filePos)
+                        : write(w->fd, p + done, n - done);
+        if (r > 0) {
+            done += (size_t)r;
+            if (w->filePos >= 0) w->filePos += r;
+        } else if (!(r < 0 && errno == EINTR)) {
+            w->failed = 1;
+        }
+    }
+}
+
+int reportFlush(ReportWriter *w)
+{
+    if (w->fd < 0) return 0; // buffer mode: nothing to flush
+
+    writeOut(w, w->buf, w->len);
+    w->len = 0;
+    return w->failed ? -1 : 0;
+}
+
+int reportWriterClose(ReportWriter *w)
+{
+    int rc = reportFlush(w);
+    if (w->owned)
+        free(w->buf);
+    w->buf = NULL;
+    w->cap = 0;
+    return rc;
+}
+
+/* ============================================================
+   Emitters
+   ============================================================ */
+
+void reportPutBytes(ReportWriter *w, const char *s, size_t n)
+{
+    if (n == 0) return; // a measuring writer has no buffer to copy into
+    w->offset += n;
+
+    if (w->len + n > w->cap) {
+        if (w->fd < 0) {
+            // Buffer mode: keep what fits, count the rest
+            size_t room = w->cap - w->len;
+            if (room) memcpy(w->buf + w->len, s, room);
+            w->len = w->cap;
+            return;
+        }
+        reportFlush(w);
+        if (n > w->cap) {
+            // Larger than the whole buffer: write it through
+            writeOut(w, s, n);
+            return;
+        }
+    }
+
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+void reportPutStr(ReportWriter *w, const char *s)
+{
+    reportPutBytes(w, s, strlen(s));
+}
+
+static const char digitPairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Digits of v, right-aligned ending at end; returns the first digit
+static char* formatUnsigned(char *end, unsigned long long v)
+{
+    char *p = end;
+    while (v >= 100) {
+        unsigned idx = (unsigned)(v % 100) * 2;
+        v /= 100;
+        *--p = digitPairs[idx + 1];
+        *--p = digitPairs[idx];
+    }
+    if (v >= 10) {
+        unsigned idx = (unsigned)v * 2;
+        *--p = digitPairs[idx + 1];
+        *--p = digitPairs[idx];
+    } else {
+        *--p = (char)('0' + v);
+    }
+    return p;
+}
+
+void reportPutLong(ReportWriter *w, long value)
+{
+    char tmp[24];
+    char *end = tmp + sizeof(tmp);
+    unsigned long long mag = value < 0 ? 0 - (unsigned long long)value
+                                       : (unsigned long long)value;
+    char *p = formatUnsigned(end, mag);
+    if (value < 0) *--p = '-';
+    reportPutBytes(w, p, (size_t)(end - p));
+}
+
+static const unsigned long long fixedStep[4] = {   // CDR_FIXED_SCALE / 10^decimals
+    CDR_FIXED_SCALE, CDR_FIXED_SCALE / 10, CDR_FIXED_SCALE / 100, CDR_FIXED_SCALE / 1000
+};
+static const unsigned long long fixedUnit[4] = { 1, 10, 100, 1000 };  // 10^decimals
+
+// Magnitude of value rounded to `decimals` places, in 10^-decimals units
+static unsigned long long fixedUnits(long long value, int decimals)
+{
+    unsigned long long mag = value < 0 ? 0 - (unsigned long long)value
+                                       : (unsigned long long)value;
+    return (mag + fixedStep[decimals] / 2) / fixedStep[decimals];
+}
+
+void reportPutFixed(ReportWriter *w, long long value, int decimals)
+{
+    if (decimals < 0) decimals = 0;
+    if (decimals > 3) decimals = 3;
+    unsigned long long units = fixedUnits(value, decimals);
+
+    char tmp[32];
+    char *end = tmp + sizeof(tmp);
+    char *p = end;
+    if (decimals > 0) {
+        unsigned long long frac = units % fixedUnit[decimals];
+        for (int i = 0; i < decimals; i++) {
+            *--p = (char)('0' + frac % 10);
+            frac /= 10;
+        }
+        *--p = '.';
+    }
+    p = formatUnsigned(p, units / fixedUnit[decimals]);
+    if (value < 0 && units != 0) *--p = '-';
+    reportPutBytes(w, p, (size_t)(end - p));
+}
+
+/* ============================================================
+   Text Lengths
+   ============================================================ */
+
+static size_t digitCount(unsigned long long v)
+{
+    size_t n = 1;
+    while (v >= 10000) {
+        v /= 10000;
+        n += 4;
+    }
+    return n + (v >= 10) + (v >= 100) + (v >= 1000);
+}
+
+size_t reportLongLength(long value)
+{
+    unsigned long long mag = value < 0 ? 0 - (unsigned long long)value
+                                       : (unsigned long long)value;
+    return digitCount(mag) + (value < 0);
+}
+
+size_t reportFixedLength(long long value, int decimals)
+{
+    if (decimals < 0) decimals = 0;
+    if (decimals > 3) decimals = 3;
+    unsigned long long units = fixedUnits(value, decimals);
+    return digitCount(units / fixedUnit[decimals]) + (decimals > 0 ? (size_t)decimals + 1 : 0) +
+           (value < 0 && units != 0);
+}
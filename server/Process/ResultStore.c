@@ -0,0 +1,177 @@
+// ResultStore.c - Resident billing results shared across sessions
+// Keeps the merged tables of the latest run per output directory in memory,
+// so searches are answered by a hash lookup instead of re-reading the text
+// reports. The reports remain the export format.
+#include "../Header/ResultStore.h"
+
+/* ============================================================
+   Store State
+   ============================================================ */
+
+static pthread_mutex_t storeLock = PTHREAD_MUTEX_INITIALIZER;
+static ResultSnapshot *lruHead = NULL; // most recently used
+static ResultSnapshot *lruTail = NULL; // eviction candidate
+static int snapshotCount = 0;
+static size_t storeBytes = 0;
+
+/* ============================================================
+   Helper Functions (Internal)
+   ============================================================ */
+
+static size_t storeCapBytes(void)
+{
+    const char *env = getenv(RESULT_STORE_MB_ENV);
+    long mb = env ? atol(env) : RESULT_STORE_MAX_MB;
+    return mb > 0 ? (size_t)mb * 1024 * 1024 : 0;
+}
+
+static size_t snapshotBytes(const ResultSnapshot *snap)
+{
+    return sizeof(*snap) +
+           snap->customers.capacity * (sizeof(long) + sizeof(Customer)) +
+           arenaBytes(&snap->customers.arena) +
+           arenaBytes(&snap->operators.arena);
+}
+
+static void freeSnapshot(ResultSnapshot *snap)
+{
+    freeCustomerTable(&snap->customers);
+    free_operator_table(&snap->operators);
+    free(snap);
+}
+
+// Caller holds storeLock
+static void unlinkSnapshot(ResultSnapshot *snap)
+{
+    if (snap->prev) snap->prev->next = snap->next;
+    else lruHead = snap->next;
+    if (snap->next) snap->next->prev = snap->prev;
+    else lruTail = snap->prev;
+    snap->prev = snap->next = NULL;
+    snapshotCount--;
+    storeBytes -= snap->bytes;
+}
+
+// Caller holds storeLock
+static void pushFront(ResultSnapshot *snap)
+{
+    snap->prev = NULL;
+    snap->next = lruHead;
+    if (lruHead) lruHead->prev = snap;
+    else lruTail = snap;
+    lruHead = snap;
+    snapshotCount++;
+    storeBytes += snap->bytes;
+}
+
+// Remove from the store and drop the store's reference. Caller holds
+// storeLock; returns the snapshot if it must now be freed (outside the lock).
+static ResultSnapshot* retireSnapshot(ResultSnapshot *snap)
+{
+    unlinkSnapshot(snap);
+    return --snap->refs == 0 ? snap : NULL;
+}
+
+// Caller holds storeLock
+static ResultSnapshot* findSnapshot(const char *output_dir)
+{
+    for (ResultSnapshot *s = lruHead; s; s = s->next)
+        if (strcmp(s->output_dir, output_dir) == 0)
+            return s;
+    return NULL;
+}
+
+/* ============================================================
+   Publish and Lookup
+   ============================================================ */
+
+void resultStorePublish(const char *output_dir, CustomerTable *customers,
+                        OperatorTable *operators, long records)
+{
+    size_t cap = storeCapBytes();
+    if (cap == 0) return; // resident results disabled
+
+    ResultSnapshot *snap = (ResultSnapshot *)calloc(1, sizeof(ResultSnapshot));
+    if (!snap) return;
+
+    // Steal the tables: the caller's copies are left empty
+    strncpy(snap->output_dir, output_dir, sizeof(snap->output_dir) - 1);
+    snap->customers = *customers;
+    snap->operators = *operators;
+    memset(customers, 0, sizeof(*customers));
+    memset(operators, 0, sizeof(*operators));
+    snap->records = records;
+    snap->bytes = snapshotBytes(snap);
+    snap->refs = 1;
+
+    ResultSnapshot *dead[RESULT_STORE_MAX_SNAPSHOTS + 2];
+    int deadCount = 0;
+
+    pthread_mutex_lock(&storeLock);
+    ResultSnapshot *old = findSnapshot(output_dir);
+    if (old && (dead[deadCount] = retireSnapshot(old)) != NULL)
+        deadCount++;
+    pushFront(snap);
+
+    // Evict least recently used snapshots (possibly the new one, if it
+    // alone exceeds the memory cap)
+    while (lruTail && (snapshotCount > RESULT_STORE_MAX_SNAPSHOTS || storeBytes > cap)) {
+        ResultSnapshot *victim = retireSnapshot(lruTail);
+        if (victim && deadCount < (int)(sizeof(dead) / sizeof(dead[0])))
+            dead[deadCount++] = victim;
+    }
+    pthread_mutex_unlock(&storeLock);
+
+    for (int i = 0; i < deadCount; i++)
+        freeSnapshot(dead[i]);
+}
+
+void resultStoreDrop(const char *output_dir)
+{
+    pthread_mutex_lock(&storeLock);
+    ResultSnapshot *snap = findSnapshot(output_dir);
+    ResultSnapshot *dead = snap ? retireSnapshot(snap) : NULL;
+    pthread_mutex_unlock(&storeLock);
+
+    if (dead)
+        freeSnapshot(dead);
+}
+
+const ResultSnapshot* resultStoreAcquire(const char *output_dir)
+{
+    pthread_mutex_lock(&storeLock);
+    ResultSnapshot *snap = findSnapshot(output_dir);
+    if (snap) {
+        snap->refs++;
+        // Mark as most recently used
+        unlinkSnapshot(snap);
+        pushFront(snap);
+    }
+    pthread_mutex_unlock(&storeLock);
+    return snap;
+}
+
+const ResultSnapshot* resultStoreAcquireFor(const char *report_path)
+{
+    char dir[256];
+    const char *slash = strrchr(report_path, '/');
+    size_t len = slash ? (size_t)(slash - report_path) : 0;
+    if (len >= sizeof(dir)) return NULL;
+
+    memcpy(dir, report_path, len);
+    dir[len] = '\0';
+    return resultStoreAcquire(slash ? dir : ".");
+}
+
+void resultStoreRelease(const ResultSnapshot *snap)
+{
+    if (!snap) return;
+
+    ResultSnapshot *s = (ResultSnapshot *)snap;
+    pthread_mutex_lock(&storeLock);
+    int last = (--s->refs == 0);
+    pthread_mutex_unlock(&storeLock);
+
+    if (last)
+        freeSnapshot(s);
+}
@@ -1,70 +1,386 @@
 // process.c - CDR processing coordinator
-// Spawns parallel threads for customer and interoperator billing processing
+// Scans the CDR file once on a pool of workers (each with private customer and
+// operator tables), merges the partial tables, writes the customer and
+// interoperator reports on parallel threads, then hands the tables to the
+// result store for searches. A checkpoint lets the next run of the same
+// directory resume from its results and scan only the appended input; in
+// follow mode the tables are copied from the live aggregates instead.
 
+#include <fcntl.h>
+#include <sys/file.h>
 #include "../Header/process.h"
+#include "../Header/ResultStore.h"
+#include "../Header/Checkpoint.h"
+#include "../Header/FileTransfer.h"
+#include "../Header/LiveFeed.h"
+#include "../Header/Log.h"
 
 /* ============================================================
    Socket Communication Helpers
    ============================================================ */
 
-int sendall_fd(int sock, const char *buf, size_t len) {
-    size_t total = 0;
-    while (total < len) {
-        ssize_t n = send(sock, buf + total, len - total, 0);
-        if (n <= 0) return -1;
-        total += n;
+int send_line_fd(int sock, const char *s) {
+    char tmp[BUFSIZE];
+    size_t len = strnlen(s, sizeof(tmp) - 1); // keep room for the newline
+    memcpy(tmp, s, len);
+    tmp[len] = '\n';
+    return send_all(sock, tmp, len + 1);
+}
+
+/* ============================================================
+   Job Lifecycle
+   ============================================================ */
+
+BillingJob* createBillingJob(const char *output_dir) {
+    BillingJob *job = (BillingJob *)calloc(1, sizeof(BillingJob));
+    if (!job) return NULL;
+    strncpy(job->output_dir, output_dir, sizeof(job->output_dir) - 1);
+    job->output_dir[sizeof(job->output_dir) - 1] = '\0';
+    return job;
+}
+
+void destroyBillingJob(BillingJob *job) {
+    if (!job) return;
+    freeCustomerTable(&job->customers);
+    free_operator_table(&job->operators);
+    free(job);
+}
+
+/* ============================================================
+   Parallel Scan and Merge
+   ============================================================ */
+
+long scanAndMerge(BillingJob *job, const char *input_path, uint64_t start, int flags,
+                  int workers) {
+    CDRScanStats stats = {0, 0};
+    if (workers < 1) workers = 1;
+    CustomerTable *custParts = (CustomerTable *)calloc(workers, sizeof(CustomerTable));
+    OperatorTable *opParts = (OperatorTable *)calloc(workers, sizeof(OperatorTable));
+    CDRAggregator *aggs = (CDRAggregator *)malloc(workers * 2 * sizeof(CDRAggregator));
+    if (!custParts || !opParts || !aggs) {
+        free(custParts);
+        free(opParts);
+        free(aggs);
+        return -1;
+    }
+
+    // Worker w feeds aggs[2w] (customer) and aggs[2w + 1] (operator)
+    for (int w = 0; w < workers; w++) {
+        aggs[2 * w] = (CDRAggregator){ "customer", customerConsumeRecord, &custParts[w] };
+        aggs[2 * w + 1] = (CDRAggregator){ "interoperator", operatorConsumeRecord, &opParts[w] };
+    }
+
+    long records = scanCDRFileFrom(input_path, start, flags, aggs, 2, workers, &stats, &job->input);
+    if (records < 0 && start == 0 && flags == 0) {
+        // Not a regular file: read it sequentially; such a run is not checkpointed
+        memset(&job->input, 0, sizeof(job->input));
+        records = scanCDRFile(input_path, aggs, 2, &stats);
     }
-    return 0;
+    job->malformed += stats.malformed;
+
+    // Merge in range order so first-seen names and output order match a
+    // sequential scan
+    for (int w = 0; w < workers; w++) {
+        if (records >= 0) {
+            mergeCustomerTable(&job->customers, &custParts[w]);
+            merge_operator_table(&job->operators, &opParts[w]);
+        }
+        freeCustomerTable(&custParts[w]);
+        free_operator_table(&opParts[w]);
+    }
+
+    free(custParts);
+    free(opParts);
+    free(aggs);
+    return records;
 }
 
-int send_line_fd(int sock, const char *s) {
-    char tmp[BUFSIZE];
-    snprintf(tmp, sizeof(tmp), "%s\n", s);
-    return sendall_fd(sock, tmp, strlen(tmp));
+/* ============================================================
+   Multi-File Input
+   ============================================================ */
+
+// One input file scanned into its own partial tables
+typedef struct {
+    BillingJob *part;
+    const char *path;
+    int workers;      // scanner threads for this file
+    long records;
+} FileScan;
+
+typedef struct {
+    FileScan *files;
+    int count;
+    int next;         // next file to claim
+} FileQueue;
+
+static void* scanFileThread(void *arg) {
+    FileQueue *q = (FileQueue *)arg;
+    int i;
+    while ((i = __sync_fetch_and_add(&q->next, 1)) < q->count) {
+        FileScan *f = &q->files[i];
+        f->records = scanAndMerge(f->part, f->path, 0, 0, f->workers);
+    }
+    return NULL;
+}
+
+// Scan every file of the set, each on its own scanner (several when there
+// are fewer files than workers), and merge the partial tables in file order.
+// Returns records scanned, or -1 if a file cannot be read (*failed names it).
+static long scanInputSet(BillingJob *job, const CDRInputSet *set, int workers,
+                         const char **failed) {
+    FileScan *files = (FileScan *)calloc(set->count, sizeof(FileScan));
+    if (!files) return -1;
+
+    int threads = set->count < workers ? set->count : workers;
+    int perFile = workers / set->count > 1 ? workers / set->count : 1;
+    long total = 0;
+    *failed = NULL;
+    for (int i = 0; i < set->count; i++) {
+        files[i].part = createBillingJob(job->output_dir);
+        files[i].path = set->paths[i];
+        files[i].workers = perFile;
+        files[i].records = -1;
+        if (!files[i].part) total = -1;
+    }
+
+    if (total == 0) {
+        FileQueue queue = { files, set->count, 0 };
+        pthread_t tids[CDR_MAX_WORKERS];
+        int started[CDR_MAX_WORKERS] = {0};
+        for (int t = 1; t < threads; t++)
+            started[t] = pthread_create(&tids[t], NULL, scanFileThread, &queue) == 0;
+        scanFileThread(&queue); // the calling thread takes files too
+        for (int t = 1; t < threads; t++)
+            if (started[t]) pthread_join(tids[t], NULL);
+    }
+
+    for (int i = 0; i < set->count; i++) {
+        if (total >= 0 && files[i].records < 0) {
+            *failed = files[i].path;
+            total = -1;
+        }
+        if (total >= 0) {
+            mergeCustomerTable(&job->customers, &files[i].part->customers);
+            merge_operator_table(&job->operators, &files[i].part->operators);
+            job->malformed += files[i].part->malformed;
+            total += files[i].records;
+        }
+        destroyBillingJob(files[i].part);
+    }
+    free(files);
+    return total;
+}
+
+/* ============================================================
+   Output Directory Lock
+   ============================================================ */
+
+// Runs of the same output directory write CB.col, IOSB.col and CDR.ckpt in
+// turn (LOCK_EX), and a resume reads them (LOCK_SH) while none is written,
+// so the checkpoint always describes the .col files next to it. Returns
+// the descriptor holding the lock, or -1 (the run goes ahead unlocked).
+static int lockOutputDir(const char *output_dir, int mode) {
+    int fd = open(output_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    while (flock(fd, mode) != 0) {
+        if (errno != EINTR) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+static void unlockOutputDir(int fd) {
+    if (fd >= 0) close(fd); // releases the lock
+}
+
+/* ============================================================
+   Checkpoint Resume
+   ============================================================ */
+
+// Load the results of the previous run into the job if its checkpoint still
+// matches the input. Returns the input offset to scan from (0: full run).
+static uint64_t resumeFromCheckpoint(BillingJob *job, const char *input_path) {
+    CDRCheckpoint ckpt;
+    if (!checkpointEnabled()) return 0;
+    int lock = lockOutputDir(job->output_dir, LOCK_SH);
+    if (loadCheckpoint(job->output_dir, input_path, &ckpt) != 0) {
+        unlockOutputDir(lock);
+        return 0;
+    }
+
+    char cb_path[300], iosb_path[300];
+    snprintf(cb_path, sizeof(cb_path), "%s/%s", job->output_dir, CB_COLUMN_FILE);
+    snprintf(iosb_path, sizeof(iosb_path), "%s/%s", job->output_dir, IOSB_COLUMN_FILE);
+    int loaded = loadCBColumnsInto(&job->customers, cb_path) == 0 &&
+                 load_iosb_columns_into(&job->operators, iosb_path) == 0;
+    unlockOutputDir(lock);
+    if (!loaded) {
+        LOG_WARN("%s: checkpoint state unreadable, processing all input", job->output_dir);
+        freeCustomerTable(&job->customers);
+        free_operator_table(&job->operators);
+        memset(&job->customers, 0, sizeof(job->customers));
+        memset(&job->operators, 0, sizeof(job->operators));
+        return 0;
+    }
+
+    job->records = (long)ckpt.records;
+    job->malformed = (long)ckpt.malformed;
+    return ckpt.offset;
 }
 
 /* ============================================================
    CDR Processing Coordinator
    ============================================================ */
 
-int processCDRdata(int client_fd, const char *output_dir) {
+// Aggregate the input selected by $CDR_INPUT into the job. Returns records
+// scanned, or -1 after telling the client what failed.
+static long processInputFiles(BillingJob *job, int client_fd) {
+    char msg[BUFSIZE];
+    CDRInputSet set;
+    if (cdrInputSetOpen(cdrInputSpec(), &set) != 0 || set.count == 0) {
+        cdrInputSetFree(&set);
+        send_line_fd(client_fd, "Error: no CDR input files found");
+        return -1;
+    }
+
+    long scanned;
+    if (set.count == 1) {
+        // Resume from the previous run's results when only new input was
+        // appended since, then scan the rest in a single pass: every record
+        // feeds both aggregators
+        snprintf(job->input_path, sizeof(job->input_path), "%s", set.paths[0]);
+        uint64_t start = resumeFromCheckpoint(job, job->input_path);
+        if (start > 0) {
+            snprintf(msg, sizeof(msg), "Processing CDR data: resuming at byte %llu (%ld records already aggregated)",
+                     (unsigned long long)start, job->records);
+            LOG_INFO("%s: resuming CDR input at byte %llu", job->output_dir, (unsigned long long)start);
+            send_line_fd(client_fd, msg);
+        }
+        scanned = scanAndMerge(job, job->input_path, start, 0, cdrWorkerCount());
+        if (scanned < 0)
+            send_line_fd(client_fd, "Error: unable to read CDR input file");
+    } else {
+        // Several files (rotated or archived): scanned side by side, never
+        // checkpointed
+        const char *failed = NULL;
+        snprintf(msg, sizeof(msg), "Processing CDR data: %d input files", set.count);
+        send_line_fd(client_fd, msg);
+        scanned = scanInputSet(job, &set, cdrWorkerCount(), &failed);
+        if (scanned < 0) {
+            snprintf(msg, sizeof(msg), "Error: unable to read CDR input file %s",
+                     failed ? failed : "");
+            LOG_WARN("%s: %s", job->output_dir, msg);
+            send_line_fd(client_fd, msg);
+        }
+    }
+
+    cdrInputSetFree(&set);
+    if (scanned < 0) return -1;
+    job->records += scanned;
+    return scanned;
+}
+
+int writeJobResults(BillingJob *job, int client_fd) {
     pthread_t t1, t2;
     int rc;
-    
-    // Allocate thread arguments
-    ProcessThreadArg *arg = (ProcessThreadArg *)malloc(sizeof(ProcessThreadArg));
-    if (!arg) {
-        send_line_fd(client_fd, "Error: memory allocation failed");
-        return 0;
-    }
-    strncpy(arg->output_dir, output_dir, sizeof(arg->output_dir) - 1);
-    arg->output_dir[sizeof(arg->output_dir) - 1] = '\0';
 
-    // Inform client that processing has started
-    send_line_fd(client_fd, "Processing CDR data: started...");
+    // Another run of this directory finishes writing its results first
+    int lock = lockOutputDir(job->output_dir, LOCK_EX);
 
-    rc = pthread_create(&t1, NULL, custbillprocess, arg);
+    rc = pthread_create(&t1, NULL, custbillprocess, job);
     if (rc != 0) {
         send_line_fd(client_fd, "Error: failed to start Customer Billing processing thread");
-        free(arg);
+        unlockOutputDir(lock);
+        destroyBillingJob(job);
         return 0;
     }
 
-    rc = pthread_create(&t2, NULL, intopbillprocess, arg);
+    rc = pthread_create(&t2, NULL, intopbillprocess, job);
     if (rc != 0) {
         send_line_fd(client_fd, "Error: failed to start Interoperator Billing processing thread");
         // join thread 1 if needed
         pthread_join(t1, NULL);
-        free(arg);
+        unlockOutputDir(lock);
+        destroyBillingJob(job);
         return 0;
     }
 
     // Optionally, while waiting, we could stream progress updates. For now just join.
     pthread_join(t1, NULL);
     pthread_join(t2, NULL);
-    
-    // Free allocated argument
-    free(arg);
+
+    // Results written from input that ends on a record boundary can be
+    // resumed by the next run; otherwise the next run starts over
+    if (!(job->customerSaved && job->operatorSaved && job->input.complete &&
+          checkpointEnabled() &&
+          saveCheckpoint(job->output_dir, job->input_path, &job->input,
+                         job->records, job->malformed) == 0))
+        removeCheckpoint(job->output_dir);
+
+    // Searches must answer from what is on disk: without both .col files
+    // any resident snapshot of this directory is dropped instead
+    if (!(job->customerSaved && job->operatorSaved)) {
+        LOG_WARN("%s: unable to save billing results (CB.col %s, IOSB.col %s)", job->output_dir,
+                 job->customerSaved ? "saved" : "failed", job->operatorSaved ? "saved" : "failed");
+        send_line_fd(client_fd, "Error: unable to save billing results");
+        resultStoreDrop(job->output_dir);
+        unlockOutputDir(lock);
+        destroyBillingJob(job);
+        return 0;
+    }
+
+    // Keep the results resident for searches, then release the job
+    resultStorePublish(job->output_dir, &job->customers, &job->operators, job->records);
+    unlockOutputDir(lock);
+    destroyBillingJob(job);
+    return 1;
+}
+
+int processCDRdata(int client_fd, const char *output_dir) {
+    // Create the job context owning this run's tables
+    BillingJob *job = createBillingJob(output_dir);
+    if (!job) {
+        send_line_fd(client_fd, "Error: memory allocation failed");
+        return 0;
+    }
+
+    // Inform client that processing has started
+    send_line_fd(client_fd, "Processing CDR data: started...");
+
+    if (liveFeedActive()) {
+        // Follow mode: the aggregates are already up to date; copy them
+        // and keep this directory refreshed from now on
+        uint64_t generation = 0;
+        if (liveFeedCopy(job, &generation) != 0) {
+            send_line_fd(client_fd, "Error: unable to read CDR input file");
+            destroyBillingJob(job);
+            return 0;
+        }
+        char msg[BUFSIZE];
+        snprintf(msg, sizeof(msg), "Processing CDR data: live aggregates up to byte %llu",
+                 (unsigned long long)job->input.end);
+        send_line_fd(client_fd, msg);
+        liveFeedRegister(output_dir, generation);
+    } else if (processInputFiles(job, client_fd) < 0) {
+        destroyBillingJob(job);
+        return 0;
+    }
+
+    // Report lines the customer billing could not use
+    if (job->malformed > 0) {
+        char msg[BUFSIZE];
+        snprintf(msg, sizeof(msg), "Processing CDR data: %ld of %ld records malformed, skipped",
+                 job->malformed, job->records);
+        LOG_WARN("%s: %ld of %ld CDR records malformed", output_dir,
+                 job->malformed, job->records);
+        send_line_fd(client_fd, msg);
+    }
+
+    // Write the reports on two threads and publish the results
+    if (!writeJobResults(job, client_fd))
+        return 0;
 
     // Both parts done
     send_line_fd(client_fd, "Processing CDR data: completed.");
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "Header/server.h"
 
 /* ============================================================
@@ -14,351 +15,790 @@ int sendall(int sock, const char *buf, size_t len) {
     return 0;
 }
 
-int send_line(int sock, const char *s) {
+int take_line(LineReader *r, char *buf, size_t bufsize) {
+    size_t idx = 0, i = r->start;
+    for (; i < r->end; i++) {
+        char c = r->data[i];
+        if (c == '\n' || idx + 1 == bufsize) break;
+        if (c != '\r') buf[idx++] = c;
+    }
+    if (i == r->end) {
+        // Incomplete; a full buffer is handed out as it is
+        if (r->start > 0 || r->end < sizeof(r->data)) return 0;
+    } else if (r->data[i] == '\n') {
+        i++;
+    }
+    buf[idx] = '\0';
+    r->start = i;
+    if (r->start == r->end) r->start = r->end = 0;
+    return 1;
+}
+
+ssize_t fill_line_reader(int sock, LineReader *r) {
+    if (r->start > 0) {
+        memmove(r->data, r->data + r->start, r->end - r->start);
+        r->end -= r->start;
+        r->start = 0;
+    }
+    ssize_t n = recv(sock, r->data + r->end, sizeof(r->data) - r->end, 0);
+    if (n > 0) r->end += (size_t)n;
+    return n;
+}
+
+/* ============================================================
+   Session Output (Event Loop)
+   ============================================================ */
+
+static int set_nonblocking(int fd, int on) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return -1;
+    flags = on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(fd, F_SETFL, flags);
+}
+
+// Send the accumulated output in one call; what the socket does not take
+// now waits for EPOLLOUT
+static void session_flush(Session *s) {
+    size_t sent = 0;
+    while (sent < s->out_len) {
+        ssize_t n = send(s->fd, s->out + sent, s->out_len - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        s->dead = 1;
+        return;
+    }
+    memmove(s->out, s->out + sent, s->out_len - sent);
+    s->out_len -= sent;
+}
+
+// Queue output. Nothing is sent here: a whole response (a message plus the
+// next menu, say) is flushed at once when the event has been handled, so it
+// leaves in as few segments as possible.
+static int session_send(Session *s, const char *buf, size_t len) {
+    if (s->dead) return -1;
+    if (s->out_len + len > SESSION_OUT_MAX) {
+        LOG_WARN("Client %s is not reading its output, disconnecting", s->ip);
+        s->dead = 1;
+        return -1;
+    }
+    if (s->out_len + len > s->out_cap) {
+        size_t cap = s->out_cap ? s->out_cap : BUFSIZE;
+        while (cap < s->out_len + len) cap *= 2;
+        char *bigger = (char *)realloc(s->out, cap);
+        if (!bigger) {
+            s->dead = 1;
+            return -1;
+        }
+        s->out = bigger;
+        s->out_cap = cap;
+    }
+    memcpy(s->out + s->out_len, buf, len);
+    s->out_len += len;
+    return 0;
+}
+
+static int session_send_line(Session *s, const char *line) {
     char tmp[BUFSIZE];
-    snprintf(tmp, sizeof(tmp), "%s\n", s);
-    return sendall(sock, tmp, strlen(tmp));
+    snprintf(tmp, sizeof(tmp), "%s\n", line);
+    return session_send(s, tmp, strlen(tmp));
 }
 
-ssize_t recv_line(int sock, char *buf, size_t bufsize) {
-    size_t idx = 0;
-    while (idx + 1 < bufsize) {
-        char c;
-        ssize_t r = recv(sock, &c, 1, 0);
-        if (r <= 0) return -1; // closed or error
-        if (c == '\n') break;
-        if (c == '\r') continue;
-        buf[idx++] = c;
+static void send_menu(Session *s) {
+    s->step = AWAIT_CHOICE;
+    if (s->state == MAIN) {
+        session_send_line(s, "-- MAIN MENU --");
+        session_send_line(s, "1) Signup");
+        session_send_line(s, "2) Login");
+        session_send_line(s, "3) Exit");
+        session_send_line(s, "Enter choice (1-3):");
+    } else if (s->state == SECOND) {
+        session_send_line(s, "-- SECONDARY MENU --");
+        session_send_line(s, "1) Process the CDR data");
+        session_send_line(s, "2) Print and search");
+        session_send_line(s, "3) Logout");
+        session_send_line(s, "Enter choice (1-3):");
+    } else if (s->state == BILLING) {
+        session_send_line(s, "-- PRINT & SEARCH MENU --");
+        session_send_line(s, "1) Customer Billing");
+        session_send_line(s, "2) Interoperator Billing");
+        session_send_line(s, "3) Back");
+        session_send_line(s, "Enter choice (1-3):");
+    } else if (s->state == CUST_BILL) {
+        session_send_line(s, "-- CUSTOMER BILLING --");
+        session_send_line(s, "1) Search by msisdn no");
+        session_send_line(s, "2) Print file content of CB.txt");
+        session_send_line(s, "3) Back");
+        session_send_line(s, "4) Exit");
+        session_send_line(s, "Enter choice (1-4):");
+    } else if (s->state == INTER_BILL) {
+        session_send_line(s, "-- INTEROP BILLING --");
+        session_send_line(s, "1) Search by operator name");
+        session_send_line(s, "2) Print file content of IOSB.txt");
+        session_send_line(s, "3) Back");
+        session_send_line(s, "4) Exit");
+        session_send_line(s, "Enter choice (1-4):");
     }
-    buf[idx] = '\0';
-    return (ssize_t)idx;
 }
 
 /* ============================================================
-   Client Thread Handling
+   Worker Pool
    ============================================================ */
 
-void* client_thread(void* arg) {
-    ClientInfo *info = (ClientInfo *)arg;
-    int client_fd = info->client_fd;
-    char client_ip[INET_ADDRSTRLEN];
-    
-    // Store client IP for logging
-    strncpy(client_ip, inet_ntoa(info->client_addr.sin_addr), INET_ADDRSTRLEN-1);
-    client_ip[INET_ADDRSTRLEN-1] = '\0';
-    
-    printf("Thread started for client %s\n", client_ip);
-    log_connection_event(client_ip, "Thread Started");
-    
-    // Free the allocated ClientInfo structure
-    free(info);
-    
-    // Handle the client
-    handle_client(client_fd);
-    
-    printf("Thread ending, client disconnected\n");
-    log_connection_event(client_ip, "Thread Ended - Client Disconnected");
-    
+// Requests that block (account file access, CDR processing, searches and
+// file output over the socket) run on a fixed set of worker threads so the
+// event loop keeps serving every other session. CDR processing can take
+// minutes: it has its own queue and may occupy at most half of the workers,
+// so the other requests always find one free.
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    Session *head, *tail;           // short requests waiting for a worker
+    Session *proc_head, *proc_tail; // CDR processing requests waiting
+    int queued;
+    int processing;                 // workers running CDR processing
+    int process_max;
+    Session *done;                  // finished, to be handed back
+    int wake_fd;                    // eventfd signalling `done` to the event loop
+    int workers;
+} pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, NULL, NULL,
+           0, 0, 0, NULL, -1, 0 };
+
+// The account file is checked and appended without locks of its own;
+// signups and logins on different workers take turns
+static pthread_mutex_t auth_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Signup and login: only the account file and the output directory are
+// touched; finish_task answers the client on the event loop
+static void run_auth_task(Session *s) {
+    pthread_mutex_lock(&auth_lock);
+    if (s->task == TASK_SIGNUP) {
+        s->task_result = save_user(s->email, s->task_arg);
+    } else {
+        s->task_result = verify_user(s->email, s->task_arg);
+        if (s->task_result) {
+            // Create user-specific output directory: Output/<sanitized_email>/
+            char sanitized[EMAIL_MAX];
+            strncpy(sanitized, s->email, EMAIL_MAX-1);
+            sanitized[EMAIL_MAX-1] = '\0';
+            // Replace @ and . with _ for safe directory name
+            for (int i = 0; sanitized[i]; i++) {
+                if (sanitized[i] == '@' || sanitized[i] == '.') {
+                    sanitized[i] = '_';
+                }
+            }
+            snprintf(s->user_output_dir, sizeof(s->user_output_dir), "Output/%s", sanitized);
+
+            // Create the directory (mkdir returns 0 on success, -1 if exists or error)
+            mkdir(s->user_output_dir, 0755);
+        }
+    }
+    pthread_mutex_unlock(&auth_lock);
+    // Do not keep the password around
+    memset(s->task_arg, 0, sizeof(s->task_arg));
+}
+
+static void run_task(Session *s) {
+    char path[300];
+
+    if (s->task == TASK_SIGNUP || s->task == TASK_LOGIN) {
+        run_auth_task(s);
+        return;
+    }
+
+    // The worker's output goes straight to the socket, after anything the
+    // event loop queued before the hand-off. The billing and processing
+    // functions send line by line; corking merges their lines into full
+    // segments until the task ends.
+    int on = 1, off = 0;
+    set_nonblocking(s->fd, 0);
+    setsockopt(s->fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+    if (s->out_len > 0) {
+        if (sendall(s->fd, s->out, s->out_len) != 0) s->dead = 1;
+        s->out_len = 0;
+    }
+
+    if (!s->dead) {
+        switch (s->task) {
+        case TASK_SIGNUP:
+        case TASK_LOGIN:
+            break; // run without the socket, above
+        case TASK_PROCESS:
+            // processCDRdata sends progress/completion messages to the client
+            processCDRdata(s->fd, s->user_output_dir);
+            break;
+        case TASK_CUST_SEARCH:
+            snprintf(path, sizeof(path), "%s/CB.txt", s->user_output_dir);
+            search_msisdn(s->fd, path, atol(s->task_arg));
+            break;
+        case TASK_CUST_PRINT:
+            snprintf(path, sizeof(path), "%s/CB.txt", s->user_output_dir);
+            display_customer_billing_file(s->fd, path);
+            break;
+        case TASK_OP_SEARCH:
+            snprintf(path, sizeof(path), "%s/IOSB.txt", s->user_output_dir);
+            search_operator(s->fd, path, s->task_arg);
+            break;
+        case TASK_OP_PRINT:
+            snprintf(path, sizeof(path), "%s/IOSB.txt", s->user_output_dir);
+            display_interoperator_billing_file(s->fd, path);
+            break;
+        }
+    }
+    setsockopt(s->fd, IPPROTO_TCP, TCP_CORK, &off, sizeof(off));
+    set_nonblocking(s->fd, 1);
+}
+
+// Next request for a worker: short requests first, CDR processing only
+// while fewer than process_max workers are at it. Caller holds pool.lock.
+static Session* take_task(void) {
+    Session *s = NULL;
+    if (pool.head) {
+        s = pool.head;
+        pool.head = s->next;
+        if (!pool.head) pool.tail = NULL;
+    } else if (pool.proc_head && pool.processing < pool.process_max) {
+        s = pool.proc_head;
+        pool.proc_head = s->next;
+        if (!pool.proc_head) pool.proc_tail = NULL;
+        pool.processing++;
+    }
+    if (s) pool.queued--;
+    return s;
+}
+
+static void* worker_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&pool.lock);
+        Session *s;
+        while (!(s = take_task()))
+            pthread_cond_wait(&pool.ready, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+
+        run_task(s);
+
+        pthread_mutex_lock(&pool.lock);
+        if (s->task == TASK_PROCESS) {
+            pool.processing--;
+            if (pool.proc_head) pthread_cond_signal(&pool.ready); // a queued run may start
+        }
+        s->next = pool.done;
+        pool.done = s;
+        pthread_mutex_unlock(&pool.lock);
+        uint64_t one = 1;
+        if (write(pool.wake_fd, &one, sizeof(one)) < 0)
+            LOG_WARN("Failed to wake the event loop: %s", strerror(errno));
+    }
     return NULL;
 }
 
+static int start_workers(void) {
+    int count = WORKERS_DEFAULT;
+    const char *env = getenv(WORKERS_ENV);
+    if (env && *env && atoi(env) > 0) count = atoi(env);
+    if (count < MIN_WORKERS) count = MIN_WORKERS;
+    if (count > MAX_WORKERS) count = MAX_WORKERS;
+
+    pool.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (pool.wake_fd < 0) return -1;
+    for (int i = 0; i < count; i++) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, worker_thread, NULL) != 0) break;
+        pthread_detach(tid);
+        pool.workers++;
+    }
+    pool.process_max = pool.workers / 2;
+    return pool.workers >= MIN_WORKERS ? 0 : -1;
+}
+
+// Queue the session's task; the session is busy until it completes.
+// Returns -1 if too many requests are already waiting.
+static int submit_task(Session *s, TaskKind kind, const char *arg) {
+    s->task = kind;
+    snprintf(s->task_arg, sizeof(s->task_arg), "%s", arg ? arg : "");
+
+    pthread_mutex_lock(&pool.lock);
+    if (pool.queued >= TASK_QUEUE_MAX) {
+        pthread_mutex_unlock(&pool.lock);
+        LOG_WARN("Task queue full, rejecting request from %s", s->ip);
+        session_send_line(s, "Server busy. Please try again later.");
+        memset(s->task_arg, 0, sizeof(s->task_arg));
+        return -1;
+    }
+    s->busy = 1;
+    s->next = NULL;
+    Session **head = kind == TASK_PROCESS ? &pool.proc_head : &pool.head;
+    Session **tail = kind == TASK_PROCESS ? &pool.proc_tail : &pool.tail;
+    if (*tail) (*tail)->next = s;
+    else *head = s;
+    *tail = s;
+    pool.queued++;
+    pthread_cond_signal(&pool.ready);
+    pthread_mutex_unlock(&pool.lock);
+    return 0;
+}
+
 /* ============================================================
    Client Request Handler (State Machine)
    ============================================================ */
 
-void handle_client(int client_fd) {
-    char buf[BUFSIZE];
-    MenuState state = MAIN;
-    int connected = 1;
-    char logged_in_user[EMAIL_MAX] = {0}; // Track logged-in user email
-    char user_output_dir[256] = {0}; // User-specific output directory
-    int cdr_processed = 0; // Track if CDR has been processed (0 = not processed, 1 = processed)
+static void handle_main_choice(Session *s, const char *buf) {
+    if (strcmp(buf, "1") == 0) {  // Signup
+        log_menu_choice("GUEST", "MAIN MENU", "Signup");
+        session_send_line(s, "Enter email:");
+        s->step = AWAIT_SIGNUP_EMAIL;
+        return;
+    } else if (strcmp(buf, "2") == 0) {  // Login
+        log_menu_choice("GUEST", "MAIN MENU", "Login");
+        session_send_line(s, "Enter email:");
+        s->step = AWAIT_LOGIN_EMAIL;
+        return;
+    } else if (strcmp(buf, "3") == 0) {
+        log_menu_choice("GUEST", "MAIN MENU", "Exit");
+        LOG_INFO("Client requested exit from main menu");
+        session_send_line(s, "Goodbye. Closing connection.");
+        s->closing = 1;
+        return;
+    }
+    LOG_DEBUG("Invalid main menu choice: %s", buf);
+    session_send_line(s, "Invalid choice. Try again.");
+    send_menu(s);
+}
 
-    LOG_DEBUG("handle_client: Starting client handler");
-    
-    while (connected) {
-        if (state == MAIN) {
-            send_line(client_fd, "-- MAIN MENU --");
-            send_line(client_fd, "1) Signup");
-            send_line(client_fd, "2) Login");
-            send_line(client_fd, "3) Exit");
-            send_line(client_fd, "Enter choice (1-3):");
-            if (recv_line(client_fd, buf, sizeof(buf)) <= 0) break;
-            if (strcmp(buf, "1") == 0) {  // Signup
-                log_menu_choice("GUEST", "MAIN MENU", "Signup");
-                
-                // Request email
-                send_line(client_fd, "Enter email:");
-                if (recv_line(client_fd, buf, sizeof(buf)) <= 0) break;
-                
-                // Validate email
-                if (!is_valid_email(buf)) {
-                    LOG_WARN("Signup failed: Invalid email format");
-                    send_line(client_fd, "Invalid email format. Returning to main menu.");
-                    continue;
-                }
-                char email[EMAIL_MAX];
-                strncpy(email, buf, EMAIL_MAX-1);
-                email[EMAIL_MAX-1] = '\0';
-                
-                // Request password
-                send_line(client_fd, "Enter password (min 6 chars, must include: uppercase, lowercase, digit, special char):");
-                if (recv_line(client_fd, buf, sizeof(buf)) <= 0) break;
-                
-                // Validate password (strong validation from auth module)
-                if (!is_valid_password(buf)) {
-                    LOG_WARN("Signup failed: Invalid password format for user: %s", email);
-                    send_line(client_fd, "Invalid password. Must be at least 6 characters with uppercase, lowercase, digit, and special character. Returning to main menu.");
-                    continue;
-                }
-                
-                // Save user (auth module checks for duplicates)
-                int result = save_user(email, buf);
-                if (result == 1) {
-                    log_auth_event(email, "Signup", 1);
-                    send_line(client_fd, "Signup successful! Please login.");
-                } else if (result == -1) {
-                    log_auth_event(email, "Signup - Duplicate", 0);
-                    send_line(client_fd, "Email already registered. Please login or use a different email.");
-                } else {
-                    log_auth_event(email, "Signup - Error", 0);
-                    send_line(client_fd, "Error creating account. Please try again.");
-                }
-            } else if (strcmp(buf, "2") == 0) {  // Login
-                log_menu_choice("GUEST", "MAIN MENU", "Login");
-                
-                // Request email
-                send_line(client_fd, "Enter email:");
-                if (recv_line(client_fd, buf, sizeof(buf)) <= 0) break;
-
-                // Validate email
-                if (!is_valid_email(buf)) {
-                    LOG_WARN("Login failed: Invalid email format");
-                    send_line(client_fd, "Invalid email format. Returning to main menu.");
-                    continue;
-                }
-                char email[EMAIL_MAX];
-                strncpy(email, buf, EMAIL_MAX-1);
-                email[EMAIL_MAX-1] = '\0';
-
-                // Request password
-                send_line(client_fd, "Enter password:");
-                if (recv_line(client_fd, buf, sizeof(buf)) <= 0) break;
-
-                // Verify credentials
-                if (verify_user(email, buf)) {
-                    // Store logged-in user email
-                    strncpy(logged_in_user, email, EMAIL_MAX-1);
-                    logged_in_user[EMAIL_MAX-1] = '\0';
-                    
-                    // Create user-specific output directory: Output/<sanitized_email>/
-                    char sanitized[EMAIL_MAX];
-                    strncpy(sanitized, email, EMAIL_MAX-1);
-                    sanitized[EMAIL_MAX-1] = '\0';
-                    // Replace @ and . with _ for safe directory name
-                    for (int i = 0; sanitized[i]; i++) {
-                        if (sanitized[i] == '@' || sanitized[i] == '.') {
-                            sanitized[i] = '_';
-                        }
-                    }
-                    snprintf(user_output_dir, sizeof(user_output_dir), "Output/%s", sanitized);
-                    
-                    // Create the directory (mkdir returns 0 on success, -1 if exists or error)
-                    mkdir(user_output_dir, 0755);
-                    
-                    log_auth_event(email, "Login", 1);
-                    send_line(client_fd, "Login successful. Welcome!");
-                    state = SECOND;
-                } else {
-                    log_auth_event(email, "Login", 0);
-                    send_line(client_fd, "Invalid credentials. Returning to main menu.");
-                }
-            } else if (strcmp(buf, "3") == 0) {
-                log_menu_choice("GUEST", "MAIN MENU", "Exit");
-                LOG_INFO("Client requested exit from main menu");
-                send_line(client_fd, "Goodbye. Closing connection.");
-                break;
-            } else {
-                LOG_DEBUG("Invalid main menu choice: %s", buf);
-                send_line(client_fd, "Invalid choice. Try again.");
-            }
-        } else if (state == SECOND) {
-            send_line(client_fd, "-- SECONDARY MENU --");
-            send_line(client_fd, "1) Process the CDR data");
-            send_line(client_fd, "2) Print and search");
-            send_line(client_fd, "3) Logout");
-            send_line(client_fd, "Enter choice (1-3):");
-            if (recv_line(client_fd, buf, sizeof(buf)) <= 0) break;
-            if (strcmp(buf, "1") == 0) {
-                log_menu_choice(logged_in_user, "SECONDARY MENU", "Process CDR Data");
-                log_processing_event(logged_in_user, "CDR Processing", "Started");
-                
-                // Process the CDR data: run two worker functions concurrently
-                // processCDRdata will send progress/completion messages to client
-                processCDRdata(client_fd, user_output_dir);
-                
-                log_processing_event(logged_in_user, "CDR Processing", "Completed");
-                cdr_processed = 1; // Mark CDR as processed
-                // remain in SECOND menu
-            } else if (strcmp(buf, "2") == 0) {
-                log_menu_choice(logged_in_user, "SECONDARY MENU", "Print and Search");
-                
-                // Check if CDR has been processed
-                if (cdr_processed == 0) {
-                    LOG_WARN("User %s attempted to access billing without processing CDR", logged_in_user);
-                    send_line(client_fd, "ERROR: Please process the CDR data first (Option 1) before accessing billing.");
-                    // Stay in SECOND menu
-                } else {
-                    state = BILLING;
-                }
-            } else if (strcmp(buf, "3") == 0) {
-                log_menu_choice(logged_in_user, "SECONDARY MENU", "Logout");
-                log_auth_event(logged_in_user, "Logout", 1);
-                memset(logged_in_user, 0, EMAIL_MAX);
-                cdr_processed = 0; // Reset CDR processed flag on logout
-                state = MAIN; // back to main menu
-            } else {
-                LOG_DEBUG("Invalid secondary menu choice: %s", buf);
-                send_line(client_fd, "Invalid choice. Try again.");
-            }
-        } else if (state == BILLING) {
-            send_line(client_fd, "-- PRINT & SEARCH MENU --");
-            send_line(client_fd, "1) Customer Billing");
-            send_line(client_fd, "2) Interoperator Billing");
-            send_line(client_fd, "3) Back");
-            send_line(client_fd, "Enter choice (1-3):");
-            if (recv_line(client_fd, buf, sizeof(buf)) <= 0) break;
-            if (strcmp(buf, "1") == 0) {
-                log_menu_choice(logged_in_user, "BILLING MENU", "Customer Billing");
-                state = CUST_BILL;
-            } else if (strcmp(buf, "2") == 0) {
-                log_menu_choice(logged_in_user, "BILLING MENU", "Interoperator Billing");
-                state = INTER_BILL;
-            } else if (strcmp(buf, "3") == 0) {
-                log_menu_choice(logged_in_user, "BILLING MENU", "Back");
-                state = SECOND;
-            } else {
-                LOG_DEBUG("Invalid billing menu choice: %s", buf);
-                send_line(client_fd, "Invalid choice. Try again.");
+// Email entered for signup or login; 1 if it is valid and was kept
+static int take_email(Session *s, const char *buf, const char *operation) {
+    if (!is_valid_email(buf)) {
+        LOG_WARN("%s failed: Invalid email format", operation);
+        session_send_line(s, "Invalid email format. Returning to main menu.");
+        send_menu(s);
+        return 0;
+    }
+    strncpy(s->email, buf, EMAIL_MAX-1);
+    s->email[EMAIL_MAX-1] = '\0';
+    return 1;
+}
+
+static void handle_signup_password(Session *s, const char *buf) {
+    // Validate password (strong validation from auth module)
+    if (!is_valid_password(buf)) {
+        LOG_WARN("Signup failed: Invalid password format for user: %s", s->email);
+        session_send_line(s, "Invalid password. Must be at least 6 characters with uppercase, lowercase, digit, and special character. Returning to main menu.");
+        send_menu(s);
+        return;
+    }
+
+    // Save user (auth module checks for duplicates) on a worker
+    if (submit_task(s, TASK_SIGNUP, buf) == 0) return;
+    send_menu(s);
+}
+
+static void handle_login_password(Session *s, const char *buf) {
+    // Check the credentials on a worker
+    if (submit_task(s, TASK_LOGIN, buf) == 0) return;
+    send_menu(s);
+}
+
+static void finish_signup(Session *s) {
+    if (s->task_result == 1) {
+        log_auth_event(s->email, "Signup", 1);
+        session_send_line(s, "Signup successful! Please login.");
+    } else if (s->task_result == -1) {
+        log_auth_event(s->email, "Signup - Duplicate", 0);
+        session_send_line(s, "Email already registered. Please login or use a different email.");
+    } else {
+        log_auth_event(s->email, "Signup - Error", 0);
+        session_send_line(s, "Error creating account. Please try again.");
+    }
+}
+
+static void finish_login(Session *s) {
+    if (s->task_result) {
+        // Store logged-in user email
+        strncpy(s->logged_in_user, s->email, EMAIL_MAX-1);
+        s->logged_in_user[EMAIL_MAX-1] = '\0';
+
+        log_auth_event(s->email, "Login", 1);
+        session_send_line(s, "Login successful. Welcome!");
+        s->state = SECOND;
+    } else {
+        log_auth_event(s->email, "Login", 0);
+        session_send_line(s, "Invalid credentials. Returning to main menu.");
+    }
+}
+
+static void handle_second_choice(Session *s, const char *buf) {
+    if (strcmp(buf, "1") == 0) {
+        log_menu_choice(s->logged_in_user, "SECONDARY MENU", "Process CDR Data");
+        log_processing_event(s->logged_in_user, "CDR Processing", "Started");
+        if (submit_task(s, TASK_PROCESS, NULL) == 0) return;
+        // remain in SECOND menu
+    } else if (strcmp(buf, "2") == 0) {
+        log_menu_choice(s->logged_in_user, "SECONDARY MENU", "Print and Search");
+
+        // Check if CDR has been processed
+        if (s->cdr_processed == 0) {
+            LOG_WARN("User %s attempted to access billing without processing CDR", s->logged_in_user);
+            session_send_line(s, "ERROR: Please process the CDR data first (Option 1) before accessing billing.");
+            // Stay in SECOND menu
+        } else {
+            s->state = BILLING;
+        }
+    } else if (strcmp(buf, "3") == 0) {
+        log_menu_choice(s->logged_in_user, "SECONDARY MENU", "Logout");
+        log_auth_event(s->logged_in_user, "Logout", 1);
+        memset(s->logged_in_user, 0, EMAIL_MAX);
+        s->cdr_processed = 0; // Reset CDR processed flag on logout
+        s->state = MAIN; // back to main menu
+    } else {
+        LOG_DEBUG("Invalid secondary menu choice: %s", buf);
+        session_send_line(s, "Invalid choice. Try again.");
+    }
+    send_menu(s);
+}
+
+static void handle_billing_choice(Session *s, const char *buf) {
+    if (strcmp(buf, "1") == 0) {
+        log_menu_choice(s->logged_in_user, "BILLING MENU", "Customer Billing");
+        s->state = CUST_BILL;
+    } else if (strcmp(buf, "2") == 0) {
+        log_menu_choice(s->logged_in_user, "BILLING MENU", "Interoperator Billing");
+        s->state = INTER_BILL;
+    } else if (strcmp(buf, "3") == 0) {
+        log_menu_choice(s->logged_in_user, "BILLING MENU", "Back");
+        s->state = SECOND;
+    } else {
+        LOG_DEBUG("Invalid billing menu choice: %s", buf);
+        session_send_line(s, "Invalid choice. Try again.");
+    }
+    send_menu(s);
+}
+
+static void handle_cust_choice(Session *s, const char *buf) {
+    if (strcmp(buf, "1") == 0) {
+        log_menu_choice(s->logged_in_user, "CUSTOMER BILLING", "Search by MSISDN");
+        session_send_line(s, "Enter MSISDN to search:");
+        s->step = AWAIT_MSISDN;
+        return;
+    } else if (strcmp(buf, "2") == 0) {
+        log_menu_choice(s->logged_in_user, "CUSTOMER BILLING", "Print CB.txt");
+        if (submit_task(s, TASK_CUST_PRINT, NULL) == 0) return;
+    } else if (strcmp(buf, "3") == 0) {
+        log_menu_choice(s->logged_in_user, "CUSTOMER BILLING", "Back");
+        s->state = BILLING;
+    } else if (strcmp(buf, "4") == 0) {
+        log_menu_choice(s->logged_in_user, "CUSTOMER BILLING", "Exit");
+        LOG_INFO("Client requested exit from customer billing menu");
+        session_send_line(s, "Goodbye. Closing connection.");
+        s->closing = 1; // disconnect client, server continues
+        return;
+    } else {
+        LOG_DEBUG("Invalid customer billing choice: %s", buf);
+        session_send_line(s, "Invalid choice. Try again.");
+    }
+    send_menu(s);
+}
+
+static void handle_msisdn(Session *s, const char *buf) {
+    long msisdn = atol(buf);
+    if (msisdn <= 0) {
+        LOG_WARN("Invalid MSISDN entered: %s", buf);
+        session_send_line(s, "Invalid MSISDN. Please enter a valid number.");
+    } else {
+        char search_val[32];
+        snprintf(search_val, sizeof(search_val), "%ld", msisdn);
+        if (submit_task(s, TASK_CUST_SEARCH, search_val) == 0) return;
+    }
+    // After search, return to secondary menu
+    log_file_operation(s->logged_in_user, "CB.txt", "Search Completed");
+    session_send_line(s, "Operation completed. Returning to secondary menu...");
+    s->state = SECOND;
+    send_menu(s);
+}
+
+static void handle_inter_choice(Session *s, const char *buf) {
+    if (strcmp(buf, "1") == 0) {
+        log_menu_choice(s->logged_in_user, "INTEROP BILLING", "Search by Operator");
+        session_send_line(s, "Enter operator name to search:");
+        s->step = AWAIT_OPERATOR;
+        return;
+    } else if (strcmp(buf, "2") == 0) {
+        log_menu_choice(s->logged_in_user, "INTEROP BILLING", "Print IOSB.txt");
+        if (submit_task(s, TASK_OP_PRINT, NULL) == 0) return;
+    } else if (strcmp(buf, "3") == 0) {
+        log_menu_choice(s->logged_in_user, "INTEROP BILLING", "Back");
+        s->state = BILLING;
+    } else if (strcmp(buf, "4") == 0) {
+        log_menu_choice(s->logged_in_user, "INTEROP BILLING", "Exit");
+        LOG_INFO("Client requested exit from interoperator billing menu");
+        session_send_line(s, "Goodbye. Closing connection.");
+        s->closing = 1; // disconnect client, server continues
+        return;
+    } else {
+        LOG_DEBUG("Invalid interop billing choice: %s", buf);
+        session_send_line(s, "Invalid choice. Try again.");
+    }
+    send_menu(s);
+}
+
+static void handle_operator(Session *s, const char *buf) {
+    if (strlen(buf) == 0) {
+        LOG_WARN("Invalid operator name entered (empty)");
+        session_send_line(s, "Invalid operator name. Please enter a valid name.");
+    } else if (submit_task(s, TASK_OP_SEARCH, buf) == 0) {
+        return;
+    }
+    // After search, return to secondary menu
+    log_file_operation(s->logged_in_user, "IOSB.txt", "Search Completed");
+    session_send_line(s, "Operation completed. Returning to secondary menu...");
+    s->state = SECOND;
+    send_menu(s);
+}
+
+// One line of client input
+static void handle_line(Session *s, const char *buf) {
+    switch (s->step) {
+    case AWAIT_SIGNUP_EMAIL:
+        if (take_email(s, buf, "Signup")) {
+            session_send_line(s, "Enter password (min 6 chars, must include: uppercase, lowercase, digit, special char):");
+            s->step = AWAIT_SIGNUP_PASSWORD;
+        }
+        return;
+    case AWAIT_SIGNUP_PASSWORD:
+        handle_signup_password(s, buf);
+        return;
+    case AWAIT_LOGIN_EMAIL:
+        if (take_email(s, buf, "Login")) {
+            session_send_line(s, "Enter password:");
+            s->step = AWAIT_LOGIN_PASSWORD;
+        }
+        return;
+    case AWAIT_LOGIN_PASSWORD:
+        handle_login_password(s, buf);
+        return;
+    case AWAIT_MSISDN:
+        handle_msisdn(s, buf);
+        return;
+    case AWAIT_OPERATOR:
+        handle_operator(s, buf);
+        return;
+    case AWAIT_CHOICE:
+        break;
+    }
+
+    switch (s->state) {
+    case MAIN:       handle_main_choice(s, buf); break;
+    case SECOND:     handle_second_choice(s, buf); break;
+    case BILLING:    handle_billing_choice(s, buf); break;
+    case CUST_BILL:  handle_cust_choice(s, buf); break;
+    case INTER_BILL: handle_inter_choice(s, buf); break;
+    }
+}
+
+// A worker finished the session's task: log it and continue the menu
+static void finish_task(Session *s) {
+    s->busy = 0;
+    switch (s->task) {
+    case TASK_SIGNUP:
+        finish_signup(s);
+        break;
+    case TASK_LOGIN:
+        finish_login(s);
+        break;
+    case TASK_PROCESS:
+        log_processing_event(s->logged_in_user, "CDR Processing", "Completed");
+        s->cdr_processed = 1; // Mark CDR as processed
+        break;
+    case TASK_CUST_SEARCH:
+        log_search_event(s->logged_in_user, "MSISDN", s->task_arg, 1);
+        log_file_operation(s->logged_in_user, "CB.txt", "Search Completed");
+        break;
+    case TASK_CUST_PRINT:
+        log_file_operation(s->logged_in_user, "CB.txt", "File Sent to Client");
+        break;
+    case TASK_OP_SEARCH:
+        log_search_event(s->logged_in_user, "Operator", s->task_arg, 1);
+        log_file_operation(s->logged_in_user, "IOSB.txt", "Search Completed");
+        break;
+    case TASK_OP_PRINT:
+        log_file_operation(s->logged_in_user, "IOSB.txt", "File Sent to Client");
+        break;
+    }
+    if (s->task != TASK_SIGNUP && s->task != TASK_LOGIN && s->task != TASK_PROCESS) {
+        // After searching or displaying, return to secondary menu
+        session_send_line(s, "Operation completed. Returning to secondary menu...");
+        s->state = SECOND;
+    }
+    send_menu(s);
+}
+
+/* ============================================================
+   Session Input (Event Loop)
+   ============================================================ */
+
+// Handle every complete line, reading until the socket is drained (edge
+// triggered). A line handed to a worker pauses the session; the rest of
+// its input is handled once the worker is done.
+static void session_input(Session *s) {
+    char line[BUFSIZE];
+    for (;;) {
+        while (!s->busy && !s->closing && !s->dead && take_line(&s->in, line, sizeof(line)))
+            handle_line(s, line);
+        if (s->busy || s->closing || s->dead) return;
+
+        ssize_t n = fill_line_reader(s->fd, &s->in);
+        if (n > 0) continue;
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        s->dead = 1; // closed or error
+        return;
+    }
+}
+
+static Session* session_open(int epfd, int fd, const struct sockaddr_in *addr) {
+    Session *s = (Session *)calloc(1, sizeof(Session));
+    if (!s) return NULL;
+    s->fd = fd;
+    s->state = MAIN;
+    strncpy(s->ip, inet_ntoa(addr->sin_addr), INET_ADDRSTRLEN-1);
+    s->ip[INET_ADDRSTRLEN-1] = '\0';
+
+    // Workers write with blocking sends; do not let a stalled client hold
+    // one forever
+    struct timeval tv = { SEND_TIMEOUT_SEC, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    // Responses are written whole (or corked), so Nagle would only delay
+    // their last segment
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = s;
+    if (set_nonblocking(fd, 1) != 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+static void session_close(Session *s) {
+    LOG_INFO("Closing client connection");
+    log_connection_event(s->ip, "Disconnected");
+    close(s->fd);
+    free(s->out);
+    free(s);
+}
+
+// Flush the output of the event just handled, then close the session if it
+// is finished; 1 if it was closed
+static int session_settle(Session *s) {
+    if (s->busy) return 0;
+    if (s->out_len > 0) session_flush(s);
+    if (s->dead || (s->closing && s->out_len == 0)) {
+        session_close(s);
+        return 1;
+    }
+    return 0;
+}
+
+/* ============================================================
+   Event Loop
+   ============================================================ */
+
+static void accept_clients(int epfd, int sockfd) {
+    for (;;) {
+        struct sockaddr_in client_addr;
+        socklen_t sin_size = sizeof(client_addr);
+        int client_fd = accept4(sockfd, (struct sockaddr *)&client_addr, &sin_size, SOCK_CLOEXEC);
+        if (client_fd == -1) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_WARN("Failed to accept connection: %s", strerror(errno));
+                perror("accept");
             }
-        } else if (state == CUST_BILL) {
-            send_line(client_fd, "-- CUSTOMER BILLING --");
-            send_line(client_fd, "1) Search by msisdn no");
-            send_line(client_fd, "2) Print file content of CB.txt");
-            send_line(client_fd, "3) Back");
-            send_line(client_fd, "4) Exit");
-            send_line(client_fd, "Enter choice (1-4):");
-            if (recv_line(client_fd, buf, sizeof(buf)) <= 0) break;
-            if (strcmp(buf, "1") == 0) {
-                log_menu_choice(logged_in_user, "CUSTOMER BILLING", "Search by MSISDN");
-                
-                // Search by MSISDN
-                send_line(client_fd, "Enter MSISDN to search:");
-                if (recv_line(client_fd, buf, sizeof(buf)) <= 0) break;
-                
-                long msisdn = atol(buf);
-                if (msisdn <= 0) {
-                    LOG_WARN("Invalid MSISDN entered: %s", buf);
-                    send_line(client_fd, "Invalid MSISDN. Please enter a valid number.");
-                } else {
-                    // Use user-specific CB.txt file
-                    char cb_path[300];
-                    snprintf(cb_path, sizeof(cb_path), "%s/CB.txt", user_output_dir);
-                    
-                    char search_val[32];
-                    snprintf(search_val, sizeof(search_val), "%ld", msisdn);
-                    
-                    // Perform search (assuming it returns success/failure)
-                    search_msisdn(client_fd, cb_path, msisdn);
-                    log_search_event(logged_in_user, "MSISDN", search_val, 1);
-                }
-                // After search, return to secondary menu
-                log_file_operation(logged_in_user, "CB.txt", "Search Completed");
-                send_line(client_fd, "Operation completed. Returning to secondary menu...");
-                state = SECOND; // Return to secondary menu
-            } else if (strcmp(buf, "2") == 0) {
-                log_menu_choice(logged_in_user, "CUSTOMER BILLING", "Print CB.txt");
-                
-                // Display CB.txt content
-                char cb_path[300];
-                snprintf(cb_path, sizeof(cb_path), "%s/CB.txt", user_output_dir);
-                display_customer_billing_file(client_fd, cb_path);
-                
-                log_file_operation(logged_in_user, "CB.txt", "File Sent to Client");
-                // After displaying, return to secondary menu
-                send_line(client_fd, "Operation completed. Returning to secondary menu...");
-                state = SECOND; // Return to secondary menu
-            } else if (strcmp(buf, "3") == 0) {
-                log_menu_choice(logged_in_user, "CUSTOMER BILLING", "Back");
-                state = BILLING;
-            } else if (strcmp(buf, "4") == 0) {
-                log_menu_choice(logged_in_user, "CUSTOMER BILLING", "Exit");
-                LOG_INFO("Client requested exit from customer billing menu");
-                send_line(client_fd, "Goodbye. Closing connection.");
-                connected = 0; // disconnect client, server continues
-            } else {
-                LOG_DEBUG("Invalid customer billing choice: %s", buf);
-                send_line(client_fd, "Invalid choice. Try again.");
+            return;
+        }
+
+        Session *s = session_open(epfd, client_fd, &client_addr);
+        if (!s) {
+            LOG_FATAL("Failed to set up session for client %s", inet_ntoa(client_addr.sin_addr));
+            close(client_fd);
+            continue;
+        }
+
+        printf("Connection from %s\n", s->ip);
+        log_connection_event(s->ip, "Connected");
+        send_menu(s);
+        session_settle(s);
+    }
+}
+
+// Hand back sessions whose tasks finished
+static void collect_finished(void) {
+    uint64_t count;
+    while (read(pool.wake_fd, &count, sizeof(count)) > 0)
+        ;
+
+    pthread_mutex_lock(&pool.lock);
+    Session *s = pool.done;
+    pool.done = NULL;
+    pthread_mutex_unlock(&pool.lock);
+
+    while (s) {
+        Session *next = s->next;
+        finish_task(s);
+        session_input(s); // input that arrived while the worker ran
+        session_settle(s);
+        s = next;
+    }
+}
+
+static void run_event_loop(int epfd, int sockfd) {
+    static int listen_tag, wake_tag;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &listen_tag;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &ev);
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &wake_tag;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, pool.wake_fd, &ev);
+
+    struct epoll_event events[MAX_EVENTS];
+    while (1) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_FATAL("epoll_wait failed: %s", strerror(errno));
+            return;
+        }
+
+        int woken = 0;
+        for (int i = 0; i < n; i++) {
+            void *tag = events[i].data.ptr;
+            if (tag == &listen_tag) {
+                accept_clients(epfd, sockfd);
+                continue;
             }
-        } else if (state == INTER_BILL) {
-            send_line(client_fd, "-- INTEROP BILLING --");
-            send_line(client_fd, "1) Search by operator name");
-            send_line(client_fd, "2) Print file content of IOSB.txt");
-            send_line(client_fd, "3) Back");
-                send_line(client_fd, "4) Exit");
-                send_line(client_fd, "Enter choice (1-4):");
-            if (recv_line(client_fd, buf, sizeof(buf)) <= 0) break;
-            if (strcmp(buf, "1") == 0) {
-                log_menu_choice(logged_in_user, "INTEROP BILLING", "Search by Operator");
-                
-                // Search by operator name
-                send_line(client_fd, "Enter operator name to search:");
-                if (recv_line(client_fd, buf, sizeof(buf)) <= 0) break;
-                
-                if (strlen(buf) == 0) {
-                    LOG_WARN("Invalid operator name entered (empty)");
-                    send_line(client_fd, "Invalid operator name. Please enter a valid name.");
-                } else {
-                    // Use user-specific IOSB.txt file
-                    char iosb_path[300];
-                    snprintf(iosb_path, sizeof(iosb_path), "%s/IOSB.txt", user_output_dir);
-                    search_operator(client_fd, iosb_path, buf);
-                    
-                    log_search_event(logged_in_user, "Operator", buf, 1);
-                }
-                    // After search, return to secondary menu
-                log_file_operation(logged_in_user, "IOSB.txt", "Search Completed");
-                    send_line(client_fd, "Operation completed. Returning to secondary menu...");
-                    state = SECOND; // Return to secondary menu
-            } else if (strcmp(buf, "2") == 0) {
-                log_menu_choice(logged_in_user, "INTEROP BILLING", "Print IOSB.txt");
-                
-                // Display IOSB.txt content
-                char iosb_path[300];
-                snprintf(iosb_path, sizeof(iosb_path), "%s/IOSB.txt", user_output_dir);
-                display_interoperator_billing_file(client_fd, iosb_path);
-                
-                log_file_operation(logged_in_user, "IOSB.txt", "File Sent to Client");
-                    // After displaying, return to secondary menu
-                    send_line(client_fd, "Operation completed. Returning to secondary menu...");
-                    state = SECOND; // Return to secondary menu
-            } else if (strcmp(buf, "3") == 0) {
-                log_menu_choice(logged_in_user, "INTEROP BILLING", "Back");
-                state = BILLING;
-                } else if (strcmp(buf, "4") == 0) {
-                    log_menu_choice(logged_in_user, "INTEROP BILLING", "Exit");
-                    LOG_INFO("Client requested exit from interoperator billing menu");
-                    send_line(client_fd, "Goodbye. Closing connection.");
-                    connected = 0; // disconnect client, server continues
-            } else {
-                LOG_DEBUG("Invalid interop billing choice: %s", buf);
-                send_line(client_fd, "Invalid choice. Try again.");
+            if (tag == &wake_tag) {
+                // Handled after the batch: a finished session may close, and
+                // must not be closed while a later event still refers to it
+                woken = 1;
+                continue;
             }
+
+            Session *s = (Session *)tag;
+            if (s->busy) continue; // the worker owns the socket
+            uint32_t e = events[i].events;
+            if (e & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) session_input(s);
+            session_settle(s);
         }
+        if (woken) collect_finished();
     }
-    
-    LOG_INFO("Closing client connection");
-    close(client_fd);
 }
 
 /* ============================================================
@@ -366,9 +806,8 @@ void handle_client(int client_fd) {
    ============================================================ */
 
 int main(void) {
-    int sockfd, client_fd;
-    struct sockaddr_in serv_addr, client_addr;
-    socklen_t sin_size = sizeof(client_addr);
+    int sockfd;
+    struct sockaddr_in serv_addr;
 
     // Initialize logging system
     if (log_init("ServerLog/server.log", LOG_DEBUG, 1) != 0) {
@@ -383,7 +822,8 @@ int main(void) {
     signal(SIGPIPE, SIG_IGN);
     LOG_DEBUG("SIGPIPE signal handler configured");
 
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    // Close-on-exec: helper processes (the zstd decoder) must not hold the port
+    sockfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (sockfd == -1) {
         LOG_FATAL("Failed to create socket: %s", strerror(errno));
         perror("socket");
@@ -421,53 +861,29 @@ int main(void) {
     printf("Server listening on port %d...\n", PORT);
     LOG_INFO("Server listening on port %d (backlog: %d)", PORT, BACKLOG);
 
-    while (1) {
-        client_fd = accept(sockfd, (struct sockaddr *)&client_addr, &sin_size);
-        if (client_fd == -1) {
-            LOG_WARN("Failed to accept connection: %s", strerror(errno));
-            perror("accept");
-            continue;
-        }
-        
-        char client_ip[INET_ADDRSTRLEN];
-        strncpy(client_ip, inet_ntoa(client_addr.sin_addr), INET_ADDRSTRLEN-1);
-        client_ip[INET_ADDRSTRLEN-1] = '\0';
-        
-        printf("Connection from %s\n", client_ip);
-        log_connection_event(client_ip, "Connected");
-        
-        // Allocate memory for client info
-        ClientInfo *info = (ClientInfo *)malloc(sizeof(ClientInfo));
-        if (!info) {
-            LOG_FATAL("Failed to allocate memory for client info");
-            fprintf(stderr, "Failed to allocate memory for client info\n");
-            close(client_fd);
-            log_connection_event(client_ip, "Rejected - Memory allocation failed");
-            continue;
-        }
-        info->client_fd = client_fd;
-        info->client_addr = client_addr;
-        
-        // Create a new thread for this client
-        pthread_t thread_id;
-        if (pthread_create(&thread_id, NULL, client_thread, info) != 0) {
-            LOG_FATAL("Failed to create thread for client %s", client_ip);
-            fprintf(stderr, "Failed to create thread for client\n");
-            free(info);
-            close(client_fd);
-            log_connection_event(client_ip, "Rejected - Thread creation failed");
-            continue;
-        }
-        
-        LOG_INFO("Thread created for client %s (Thread ID: %lu)", client_ip, (unsigned long)thread_id);
-        
-        // Detach the thread so it cleans up automatically when done
-        pthread_detach(thread_id);
-        
-        // Continue accepting new clients immediately
+    // Follow mode ($CDR_FOLLOW=1): keep the CDR aggregates current in the background
+    if (liveFeedStart(cdrInputSpec()) < 0)
+        LOG_WARN("Failed to start follow mode, CDR data is processed on request only");
+
+    // One event loop serves every session; long requests go to the workers
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd == -1 || set_nonblocking(sockfd, 1) != 0 || start_workers() != 0) {
+        LOG_FATAL("Failed to set up the event loop: %s", strerror(errno));
+        perror("epoll");
+        if (epfd != -1) close(epfd);
+        liveFeedStop();
+        close(sockfd);
+        log_cleanup();
+        return 1;
     }
+    LOG_INFO("Event loop started with %d worker threads", pool.workers);
+    LOG_INFO("CDR scanning: %d workers, %s delimiter search", cdrWorkerCount(), cdrSplitImpl());
+
+    run_event_loop(epfd, sockfd);
 
     LOG_INFO("Server shutting down");
+    liveFeedStop();
+    close(epfd);
     close(sockfd);
     log_cleanup();
     return 0;